@@ -33,11 +33,42 @@ void ASCII::Teardown() {
 ///   @param dt - time from last update                                       
 bool ASCII::Update(Time) {
    LANGULUS(PROFILE);
-   for (auto& renderer : mRenderers)
-      renderer.Draw();
+
+   // Compile all renderers on this thread, because compilation touches 
+   // the scene, and might create content                               
+   ::std::vector<ASCIIRenderer*> renderers;
+   for (auto& renderer : mRenderers) {
+      renderer.Prepare();
+      renderers.push_back(&renderer);
+   }
+
+   // Renderers are independent, so they are rendered in parallel       
+   if (renderers.size() > 1) {
+      mWorkers.ParallelFor(renderers.size(), [&](size_t i) {
+         renderers[i]->Render();
+      });
+   }
+   else for (auto renderer : renderers)
+      renderer->Render();
+
+   // Present in the same order, in which renderers were created        
+   for (auto renderer : renderers)
+      renderer->Present();
    return true;
 }
 
+/// Get the thread pool, shared by all renderers                              
+///   @return the thread pool                                                 
+auto ASCII::GetWorkers() noexcept -> ASCIIThreadPool& {
+   return mWorkers;
+}
+
+/// Get the cache of converted geometry, shared by all renderers              
+///   @return the geometry cache                                              
+auto ASCII::GetGeometryCache() const noexcept -> const ASCIIGeometryCache& {
+   return mGeometryCache;
+}
+
 /// Create/destroy renderers                                                  
 ///   @param verb - the creation/destruction verb                             
 void ASCII::Create(Verb& verb) {
@@ -7,6 +7,8 @@
 ///                                                                           
 #pragma once
 #include "ASCIIRenderer.hpp"
+#include "inner/ASCIIThreadPool.hpp"
+#include "inner/ASCIIGeometryCache.hpp"
 
 
 ///                                                                           
@@ -24,10 +26,19 @@ protected:
 
    // List of renderer components                                       
    TFactory<ASCIIRenderer> mRenderers;
+   // Converted geometry, persisted between runs                        
+   ASCIIGeometryCache mGeometryCache;
+   // Workers shared by all renderers, for parallel compilation         
+   // Declared after the cache, so that background conversions, which   
+   // write to the cache, are joined before it's destroyed              
+   ASCIIThreadPool mWorkers;
 
 public:
    ASCII(Runtime*, const Many&);
 
+   auto GetWorkers() noexcept -> ASCIIThreadPool&;
+   auto GetGeometryCache() const noexcept -> const ASCIIGeometryCache&;
+
    bool Update(Time);
    void Create(Verb&);
    void Teardown();
@@ -15,6 +15,9 @@ ASCIICamera::ASCIICamera(ASCIILayer* producer, const Many& descriptor)
    : Resolvable   {this}
    , ProducedFrom {producer, descriptor} {
    VERBOSE_ASCII("Initializing...");
+   descriptor.ForEach([this](const Range2& rect) {
+      mRect = rect;
+   });
    Couple(descriptor);
    VERBOSE_ASCII("Initialized");
 }
@@ -28,9 +31,25 @@ void ASCIICamera::Compile() {
    if (mResolution.y <= 1u)
       mResolution.y = 1u;
 
-   mAspectRatio = static_cast<Real>(mResolution.x)
-                / static_cast<Real>(mResolution.y*2); // Chars are twice as big in the vertical
-   mViewport.mMax.xy() = mResolution;
+   // Snap the camera's rectangle to whole cells, and keep at least     
+   // one cell, so that the projection stays valid                      
+   const auto sizex = static_cast<int>(mResolution.x);
+   const auto sizey = static_cast<int>(mResolution.y);
+   const auto x0 = static_cast<int>(::std::round(mRect.mMin.x * sizex));
+   const auto y0 = static_cast<int>(::std::round(mRect.mMin.y * sizey));
+   const auto x1 = static_cast<int>(::std::round(mRect.mMax.x * sizex));
+   const auto y1 = static_cast<int>(::std::round(mRect.mMax.y * sizey));
+   mScissor = ASCIIRect {x0, y0, x1 - x0, y1 - y0}.Clip(sizex, sizey);
+   if (mScissor.IsEmpty()) {
+      mScissor.mX = ::std::min(mScissor.mX, sizex - 1);
+      mScissor.mY = ::std::min(mScissor.mY, sizey - 1);
+      mScissor.mWidth = mScissor.mHeight = 1;
+   }
+
+   mAspectRatio = static_cast<Real>(mScissor.mWidth)
+                / static_cast<Real>(mScissor.mHeight*2); // Chars are twice as big in the vertical
+   mViewport.mMin.xy() = Vec2 {mScissor.mX, mScissor.mY};
+   mViewport.mMax.xy() = Vec2 {mScissor.mX + mScissor.mWidth, mScissor.mY + mScissor.mHeight};
 
    if (mPerspective) {
       // Perspective is enabled, so use FOV, aspect ratio, and viewport 
@@ -71,8 +90,8 @@ void ASCIICamera::Compile() {
 
       mProjection = mProjection.Null();
       const auto range = mViewport.mMax.z - mViewport.mMin.z;
-      mProjection.mArray[0]  =  2.0_real / static_cast<Real>(mResolution.x);
-      mProjection.mArray[5]  = -2.0_real / static_cast<Real>(mResolution.y);
+      mProjection.mArray[0]  =  2.0_real / static_cast<Real>(mScissor.mWidth);
+      mProjection.mArray[5]  = -2.0_real / static_cast<Real>(mScissor.mHeight);
       mProjection.mArray[10] = -2.0_real / range;
       mProjection.mArray[12] = -1._real;
       mProjection.mArray[13] =  1._real;
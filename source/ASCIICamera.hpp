@@ -7,6 +7,7 @@
 ///                                                                           
 #pragma once
 #include "Common.hpp"
+#include "inner/ASCIIBuffer.hpp"
 #include <Langulus/Physical.hpp>
 #include <Langulus/Math/Range.hpp>
  
@@ -46,6 +47,12 @@ protected:
    Mat4 mProjectionInverted;
    // The screen resolution (can be bigger than the viewport)           
    Scale2u32 mResolution {640, 480};
+   // The part of the screen the camera renders to, relative to the     
+   // screen resolution. Covers the whole screen by default             
+   Range2 mRect {{0, 0}, {1, 1}};
+   // mRect in cells, compiled from the screen resolution. Nothing      
+   // outside of it is touched when rendering from this camera          
+   ASCIIRect mScissor;
 
 public:
    ASCIICamera(ASCIILayer*, const Many& = {});
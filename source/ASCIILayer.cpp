@@ -8,6 +8,9 @@
 #include "ASCII.hpp"
 #include <Langulus/Platform.hpp>
 #include <Langulus/Physical.hpp>
+#include <span>
+#include <string_view>
+#include <unordered_set>
 
 
 /// Descriptor constructor                                                    
@@ -25,10 +28,15 @@ ASCIILayer::ASCIILayer(ASCIIRenderer* producer, const Many& descriptor)
 
 /// First stage destruction                                                   
 void ASCIILayer::Teardown() {
+   mInstanceTree.Clear();
+   mInstanceProxies.clear();
+   mCoverage.Reset();
    mImage.Reset();
    mDepth.Reset();
-   mHierarchicalSequence.Reset();
-   mBatchSequence.Reset();
+   mShadowmaps.clear();
+   mShadowCache.clear();
+   mScenes[0].Reset();
+   mScenes[1].Reset();
    mLights.Teardown();
    mRenderables.Teardown();
    mFallbackCamera.TeardownInner();
@@ -47,11 +55,28 @@ void ASCIILayer::Create(Verb& verb) {
 ///   @param pipelines - [out] a set of all used pipelines                    
 ///   @return true if anything renderable was generated                       
 void ASCIILayer::Generate() {
-   mBatchSequence.Clear();
-   mHierarchicalSequence.Clear();
-
+   GetCompiling().Clear();
    CompileCameras();
    CompileLevels();
+   CompileShadows();
+}
+
+/// Publish the last generated scene, making it the one that is rendered      
+///   @attention must not be called while the layer is rendering              
+void ASCIILayer::Publish() {
+   mPublished ^= 1;
+}
+
+/// Get the scene that is currently being compiled                            
+///   @return the compiled scene                                              
+auto ASCIILayer::GetCompiling() noexcept -> CompiledScene& {
+   return mScenes[mPublished ^ 1];
+}
+
+/// Get the scene that is currently being rendered                            
+///   @return the published scene                                             
+auto ASCIILayer::GetPublished() const noexcept -> const CompiledScene& {
+   return mScenes[mPublished];
 }
 
 /// Compile the camera transformations                                        
@@ -61,82 +86,279 @@ void ASCIILayer::CompileCameras() {
 }
 
 /// Compile all levels and their instances                                    
-///   @return the number of relevant cameras                                  
+/// Potentially visible instances are first queried from the instance tree.   
+/// Their culling is then distributed across the thread pool, in chunks for   
+/// each camera and level, and the results are merged in the same order, in   
+/// which they would've been compiled serially                                
 void ASCIILayer::CompileLevels() {
+   // Gather all camera & level pairs that have to be compiled          
+   auto& jobs = mJobs;
+   jobs.clear();
+   auto addJob = [&jobs](const ASCIICamera& cam, Level level) {
+      const auto view = cam.GetViewTransform(level);
+      jobs.push_back({
+         &cam, LOD {level, view, cam.mProjection},
+         cam.mProjection * view.Invert()
+      });
+   };
+
+   // Levels without any renderables are never compiled                 
+   CompileOccupancy();
+
    if (not mCameras) {
       mFallbackCamera.mPerspective = false;
       mFallbackCamera.Compile();
 
       // No camera, so just render default level on the whole screen    
-      if (mStyle & Style::Hierarchical)
-         CompileLevelHierarchical(mFallbackCamera, Level::Default);
-      else
-         CompileLevelBatched(mFallbackCamera, Level::Default);
+      if (IsOccupied(Level::Default))
+         addJob(mFallbackCamera, Level::Default);
    }
    else for (const auto& cam : mCameras) {
       if (mStyle & Style::Multilevel) {
-         // Multilevel style - tests all camera-visible levels          
-         for (auto level  = cam.mObservableRange.mMax;
-                   level >= cam.mObservableRange.mMin; --level) {
-            if (mStyle & Style::Hierarchical)
-               CompileLevelHierarchical(cam, level);
-            else
-               CompileLevelBatched(cam, level);
+         // Multilevel style - tests all camera-visible levels, that    
+         // are occupied, walking the occupancy index backwards         
+         for (auto range = mOccupancy.rbegin(); range != mOccupancy.rend(); ++range) {
+            const auto top = ::std::min(range->mMax, cam.mObservableRange.mMax);
+            const auto bottom = ::std::max(range->mMin, cam.mObservableRange.mMin);
+            for (auto level = top; level >= bottom; --level)
+               addJob(cam, level);
          }
       }
-      else if (cam.mObservableRange.Contains(Level::Default)) {
+      else if (cam.mObservableRange.Contains(Level::Default)
+      and IsOccupied(Level::Default)) {
          // Default level style - checks only if camera sees default    
-         if (mStyle & Style::Hierarchical)
-            CompileLevelHierarchical(cam, Level::Default);
+         addJob(cam, Level::Default);
+      }
+   }
+
+   GatherEntries();
+   RefitInstances();
+   if (jobs.empty() or mEntries.empty())
+      return;
+
+   // Each instance is considered by the jobs of its own level, even if 
+   // the instance tree rejects it without testing. Renderables without 
+   // instances are considered by all jobs                              
+   ::std::map<Level, size_t> instances;
+   size_t uninstanced = 0;
+   for (const auto& entry : mEntries) {
+      if (not entry.mRenderable)
+         continue;
+      if (entry.mInstance)
+         ++instances[entry.mInstance->GetLevel()];
+      else
+         ++uninstanced;
+   }
+
+   auto& considered = GetCompiling().mInstancesConsidered;
+   for (const auto& job : jobs) {
+      considered += uninstanced;
+      const auto found = instances.find(job.mLOD.mLevel);
+      if (found != instances.end())
+         considered += found->second;
+   }
+
+   // Collect the potentially visible entries for each job, keeping     
+   // them in the order they were gathered. Instances are visible only  
+   // from their own level, same as in A::Instance::Cull                
+   ::std::vector<::std::vector<size_t>> visible(jobs.size());
+   ::std::vector<LevelTask> tasks;
+   for (size_t j = 0; j < jobs.size(); ++j) {
+      auto& list = visible[j];
+      const auto level = jobs[j].mLOD.mLevel;
+      mInstanceTree.Query(jobs[j].mProjectedView, [&](size_t entry) {
+         if (mEntries[entry].mInstance->GetLevel() == level)
+            list.push_back(entry);
+      });
+
+      const auto queried = static_cast<ptrdiff_t>(list.size());
+      ::std::sort(list.begin(), list.end());
+      list.insert(list.end(), mUnbounded.begin(), mUnbounded.end());
+      ::std::inplace_merge(list.begin(), list.begin() + queried, list.end());
+
+      for (size_t b = 0; b < list.size(); b += CompileChunkSize)
+         tasks.push_back({j, b, ::std::min(b + CompileChunkSize, list.size())});
+   }
+
+   // Cull all potentially visible entries in parallel, each task       
+   // producing its own list of visible entries                         
+   ::std::vector<::std::vector<CulledEntry>> culled(tasks.size());
+   GetProducer()->GetProducer()->GetWorkers().ParallelFor(tasks.size(),
+      [&](size_t t) {
+         const auto& task = tasks[t];
+         const auto& job = jobs[task.mJob];
+         const auto& list = visible[task.mJob];
+         auto& output = culled[t];
+         for (auto i = task.mBegin; i < task.mEnd; ++i) {
+            const auto& entry = mEntries[list[i]];
+            LOD lod = job.mLOD;
+            if (CullEntry(entry, lod))
+               output.push_back({&entry, lod});
+         }
+      }
+   );
+
+   // Merge in a deterministic order. Pipelines, geometry and textures  
+   // might be lazily created while caching, so this part is serial     
+   for (size_t t = 0; t < tasks.size(); ++t) {
+      const auto& job = jobs[tasks[t].mJob];
+      for (auto& it : culled[t]) {
+         if (it.mEntry->mLight)
+            CompileLight(it.mEntry->mLight, it.mEntry->mInstance, it.mLOD, *job.mCamera);
          else
-            CompileLevelBatched(cam, Level::Default);
+            CompileInstance(it.mEntry->mRenderable, it.mEntry->mInstance, it.mLOD, job);
       }
    }
 }
 
-/// Compile a single level's instances hierarchical style                     
-///   @param cam - the camera to compile                                      
-///   @param level - the level to compile                                     
-void ASCIILayer::CompileLevelHierarchical(const ASCIICamera& cam, Level level) {
-   // Construct view and frustum for culling                            
-   LOD lod {level, cam.GetViewTransform(level), cam.mProjection};
-
-   // Nest-iterate all children of the layer owner                      
-   for (const auto& owner : GetOwners())
-      CompileThing(owner, lod, cam);
+/// Build the occupancy index - a sorted list of disjoint level ranges, that  
+/// contain at least one renderable instance. Built from the level ranges,    
+/// that renderables track on Refresh(). Lights don't occupy levels, because  
+/// they're compiled only where there are renderables                         
+void ASCIILayer::CompileOccupancy() {
+   mOccupancy.clear();
+   for (const auto& renderable : mRenderables) {
+      if (not renderable.mInstances)
+         mOccupancy.push_back({Level::Default, Level::Default});
+      else
+         mOccupancy.push_back(renderable.mLevelRange);
+   }
+
+   if (mOccupancy.empty())
+      return;
+
+   // Sort and merge overlapping ranges                                 
+   ::std::sort(mOccupancy.begin(), mOccupancy.end(),
+      [](const LevelRange& a, const LevelRange& b) {
+         return a.mMin < b.mMin;
+      });
+
+   size_t merged = 0;
+   for (size_t i = 1; i < mOccupancy.size(); ++i) {
+      auto& last = mOccupancy[merged];
+      auto next = mOccupancy[i];
+      if (next.mMin <= last.mMax) {
+         if (next.mMax > last.mMax)
+            last.mMax = next.mMax;
+      }
+      else mOccupancy[++merged] = next;
+   }
+   mOccupancy.resize(merged + 1);
 }
 
-/// Compile a single level's instances batched style                          
-///   @param cam - the camera to compile                                      
-///   @param level - the level to compile                                     
-void ASCIILayer::CompileLevelBatched(const ASCIICamera& cam, Level level) {
-   // Construct view and frustum for culling                            
-   LOD lod {level, cam.GetViewTransform(level), cam.mProjection};
+/// Check if a level contains any renderables                                 
+///   @param level - the level to check                                       
+///   @return true if the level is in the occupancy index                     
+bool ASCIILayer::IsOccupied(Level level) const {
+   auto range = ::std::upper_bound(mOccupancy.begin(), mOccupancy.end(), level,
+      [](Level l, const LevelRange& r) {
+         return l < r.mMin;
+      });
+   if (range == mOccupancy.begin())
+      return false;
+   return level <= (--range)->mMax;
+}
+
+/// Refit the instance tree to the gathered entries. Instanced renderables    
+/// with cached geometry are inserted or moved, while the proxies of those    
+/// no longer in the layer are removed                                        
+void ASCIILayer::RefitInstances() {
+   ++mGeneration;
+   mUnbounded.clear();
+
+   // Only instanced renderables with already cached geometry have      
+   // bounds - everything else has to be tested for every job           
+   ::std::vector<size_t> bounded;
+   for (size_t i = 0; i < mEntries.size(); ++i) {
+      const auto& entry = mEntries[i];
+      if (entry.mRenderable and entry.mInstance and entry.mRenderable->GetBounds())
+         bounded.push_back(i);
+      else
+         mUnbounded.push_back(i);
+   }
+
+   // Transform the bounds in parallel                                  
+   ::std::vector<Mat4> models(bounded.size());
+   ::std::vector<ASCIIBounds> world(bounded.size());
+   const size_t chunks = (bounded.size() + CompileChunkSize - 1) / CompileChunkSize;
+   GetProducer()->GetProducer()->GetWorkers().ParallelFor(chunks,
+      [&](size_t c) {
+         const auto end = ::std::min((c + 1) * CompileChunkSize, bounded.size());
+         for (auto i = c * CompileChunkSize; i < end; ++i) {
+            const auto& entry = mEntries[bounded[i]];
+            models[i] = entry.mInstance->GetModelTransform(entry.mInstance->GetLevel());
+            world[i] = entry.mRenderable->GetBounds()->Transform(models[i]);
+         }
+      }
+   );
+
+   // Update the tree - proxies are reinserted only if they left their  
+   // fattened bounds                                                   
+   for (size_t i = 0; i < bounded.size(); ++i) {
+      const auto& entry = mEntries[bounded[i]];
+      auto [it, created] = mInstanceProxies.try_emplace(
+         InstanceKey {entry.mRenderable, entry.mInstance});
+      auto& proxy = it->second;
+
+      if (created)
+         proxy.mProxy = mInstanceTree.CreateProxy(world[i], bounded[i]);
+      else {
+         mInstanceTree.MoveProxy(proxy.mProxy, world[i]);
+         mInstanceTree.SetValue(proxy.mProxy, bounded[i]);
+      }
+
+      proxy.mStatic = not created and proxy.mModel == models[i];
+      proxy.mModel = models[i];
+      proxy.mGeneration = mGeneration;
+   }
+
+   if (mInstanceProxies.size() == bounded.size())
+      return;
+
+   // Remove the proxies of instances, that weren't gathered            
+   ::std::erase_if(mInstanceProxies, [&](const auto& pair) {
+      if (pair.second.mGeneration == mGeneration)
+         return false;
+      mInstanceTree.DestroyProxy(pair.second.mProxy);
+      return true;
+   });
+}
+
+/// Flatten all renderable and light instances in the order they have to be   
+/// compiled. Batched layers compile all renderables first, then all lights,  
+/// while hierarchical layers follow the order of the entity hierarchy        
+void ASCIILayer::GatherEntries() {
+   mEntries.clear();
+
+   if (mStyle & Style::Hierarchical) {
+      // Nest-iterate all children of the layer owner                   
+      for (const auto& owner : GetOwners())
+         GatherThing(owner);
+      return;
+   }
 
    // Iterate all renderables                                           
    for (const auto& renderable : mRenderables) {
       if (not renderable.mInstances)
-         CompileInstance(&renderable, nullptr, lod, cam);
+         mEntries.push_back({&renderable, nullptr, nullptr});
       else for (auto instance : renderable.mInstances)
-         CompileInstance(&renderable, instance, lod, cam);
+         mEntries.push_back({&renderable, nullptr, instance});
    }
 
    // Iterate all lights. Lights will be added only if there are        
    // renderables for the given camera                                  
    for (const auto& light : mLights) {
       if (not light.mInstances)
-         CompileLight(&light, nullptr, lod, cam);
+         mEntries.push_back({nullptr, &light, nullptr});
       else for (auto instance : light.mInstances)
-         CompileLight(&light, instance, lod, cam);
+         mEntries.push_back({nullptr, &light, instance});
    }
 }
 
-/// Compile an entity and all of its children entities                        
+/// Flatten an entity and all of its children entities                        
 /// Used only for hierarchical styled layers                                  
-///   @param thing - entity to compile                                        
-///   @param lod - the lod state to use                                       
-///   @param cam - the camera to compile                                      
-void ASCIILayer::CompileThing(const Thing* thing, LOD& lod, const ASCIICamera& cam) {
+///   @param thing - entity to flatten                                        
+void ASCIILayer::GatherThing(const Thing* thing) {
    // Iterate all renderables of the entity, which are part of this     
    // layer - disregard all others layers                               
    auto renderables = thing->GatherUnits<ASCIIRenderable, Seek::Here>();
@@ -145,9 +367,9 @@ void ASCIILayer::CompileThing(const Thing* thing, LOD& lod, const ASCIICamera& c
          continue;
 
       if (not renderable->mInstances)
-         CompileInstance(renderable, nullptr, lod, cam);
+         mEntries.push_back({renderable, nullptr, nullptr});
       else for (auto instance : renderable->mInstances)
-         CompileInstance(renderable, instance, lod, cam);
+         mEntries.push_back({renderable, nullptr, instance});
    }
 
    // Iterate all lights of the entity, which are part of this          
@@ -159,39 +381,56 @@ void ASCIILayer::CompileThing(const Thing* thing, LOD& lod, const ASCIICamera& c
          continue;
 
       if (not light->mInstances)
-         CompileLight(light, nullptr, lod, cam);
+         mEntries.push_back({nullptr, light, nullptr});
       else for (auto instance : light->mInstances)
-         CompileLight(light, instance, lod, cam);
+         mEntries.push_back({nullptr, light, instance});
    }
 
    // Nest to children                                                  
    for (auto child : thing->GetChildren())
-      CompileThing(child, lod, cam);
+      GatherThing(child);
 }
 
-/// Compile a single renderable instance, culling it if able                  
+/// Cull a single entry, and transform its LOD state if visible               
+///   @attention this runs in parallel, so it must only read the scene        
+///   @param entry - the entry to cull                                        
+///   @param lod - [in/out] the LOD state of the camera and level             
+///   @return true if the entry is visible and has to be compiled             
+bool ASCIILayer::CullEntry(const LayerEntry& entry, LOD& lod) const {
+   if (not entry.mInstance) {
+      // No instances, so culling based only on default level           
+      if (lod.mLevel != Level::Default)
+         return false;
+      if (entry.mRenderable)
+         lod.Transform();
+      return true;
+   }
+
+   // Lights are transformed and culled by their influence volume,      
+   // when compiled, because that depends on the compiled renderables   
+   if (entry.mLight)
+      return true;
+
+   // Instance available, so do frustum culling                         
+   if (entry.mInstance->Cull(lod))
+      return false;
+
+   lod.Transform(entry.mInstance->GetModelTransform(lod));
+   return true;
+}
+
+/// Compile a single renderable instance, that already passed culling         
 /// This will create or reuse a pipeline, capable of rendering it             
 ///   @param renderable - the renderable to compile                           
 ///   @param instance - the instance to compile                               
-///   @param lod - the lod state to use                                       
-///   @param cam - the camera to compile                                      
+///   @param lod - the lod state to use, already transformed by CullEntry     
+///   @param job - the camera and level to compile                            
 void ASCIILayer::CompileInstance(
    const ASCIIRenderable* renderable,
    const A::Instance* instance,
-   LOD& lod, const ASCIICamera& cam
+   LOD& lod, const LevelJob& job
 ) {
-   if (not instance) {
-      // No instances, so culling based only on default level           
-      if (lod.mLevel != Level::Default)
-         return;
-      lod.Transform();
-   }
-   else {
-      // Instance available, so do frustum culling                      
-      if (instance->Cull(lod))
-         return;
-      lod.Transform(instance->GetModelTransform(lod));
-   }
+   const auto& cam = *job.mCamera;
 
    // Get relevant pipeline and geometry                                
    const auto* pipeline = renderable->GetOrCreatePipeline(lod, this);
@@ -202,66 +441,117 @@ void ASCIILayer::CompileInstance(
    if (not geometry)
       return;
 
+   // Instances that didn't move since the last frame cast static       
+   // shadows, that are cached. Uninstanced renderables never move      
+   bool still = true;
+   if (instance) {
+      const auto proxy = mInstanceProxies.find(InstanceKey {renderable, instance});
+      still = proxy != mInstanceProxies.end() and proxy->second.mStatic;
+   }
+
+   // Instances completely past the fog would be drawn only in fog      
+   // color, so they aren't drawn at all. They're still part of the     
+   // content, and cast shadows on the visible instances                
+   const auto bounds = geometry->GetBounds().Transform(lod.mModel);
+   const bool fogged = pipeline->IsFogged(bounds, job.mProjectedView);
+
+   // Extend the content bounds of a level, for light culling, and      
+   // register the instance as a potential shadow caster                
+   auto embrace = [&](auto& level) {
+      level.mContent = level.mHasContent ? level.mContent.Merge(bounds) : bounds;
+      level.mHasContent = true;
+      level.mCasters << ShadowCaster {geometry, lod.mModel, still, renderable, instance};
+      if (not fogged)
+         level.mFarDepth = ::std::max(level.mFarDepth, pipeline->GetFogDepth());
+   };
+
    // Cache the instance in the appropriate sequence                    
+   auto& scene = GetCompiling();
    if (mStyle & Style::Hierarchical) {
-      auto cachedCam = mHierarchicalSequence.FindIt(&cam);
+      auto cachedCam = scene.mHierarchicalSequence.FindIt(&cam);
       if (not cachedCam) {
-         mHierarchicalSequence.Insert(&cam);
-         cachedCam = mHierarchicalSequence.FindIt(&cam);
+         scene.mHierarchicalSequence.Insert(&cam);
+         cachedCam = scene.mHierarchicalSequence.FindIt(&cam);
       }
 
       auto cachedLvl = cachedCam.GetValue().FindIt(-lod.mLevel);
       if (not cachedLvl) {
          cachedCam.GetValue().Insert(-lod.mLevel);
          cachedLvl = cachedCam.GetValue().FindIt(-lod.mLevel);
+         cachedLvl.GetValue().mProjectedView = job.mProjectedView;
+         cachedLvl.GetValue().mScissor = cam.mScissor;
       }
 
+      embrace(cachedLvl.GetValue());
+      if (fogged)
+         return;
+      ++scene.mInstancesDrawn;
+
       auto& cachedPipes = cachedLvl.GetValue().mPipelines;
       cachedPipes << TPair { pipeline, PipeSubscriber {
          instance
             ? renderable->GetColor() * instance->GetColor()
             : renderable->GetColor(),
          lod.mModel, 
-         renderable->GetGeometry(lod),
+         geometry,
          renderable->GetTexture(lod)
       }};
    }
    else {
-      auto cachedCam = mBatchSequence.FindIt(&cam);
+      auto cachedCam = scene.mBatchSequence.FindIt(&cam);
       if (not cachedCam) {
-         mBatchSequence.Insert(&cam);
-         cachedCam = mBatchSequence.FindIt(&cam);
+         scene.mBatchSequence.Insert(&cam);
+         cachedCam = scene.mBatchSequence.FindIt(&cam);
       }
 
       auto cachedLvl = cachedCam.GetValue().FindIt(-lod.mLevel);
       if (not cachedLvl) {
          cachedCam.GetValue().Insert(-lod.mLevel);
          cachedLvl = cachedCam.GetValue().FindIt(-lod.mLevel);
+         cachedLvl.GetValue().mProjectedView = job.mProjectedView;
+         cachedLvl.GetValue().mScissor = cam.mScissor;
       }
 
+      embrace(cachedLvl.GetValue());
+      if (fogged)
+         return;
+      ++scene.mInstancesDrawn;
+
       auto cachedPipe = cachedLvl.GetValue().mPipelines.FindIt(pipeline);
       if (not cachedPipe) {
          cachedLvl.GetValue().mPipelines.Insert(pipeline);
          cachedPipe = cachedLvl.GetValue().mPipelines.FindIt(pipeline);
       }
 
-      auto& cachedRends = cachedPipe.GetValue();
-      cachedRends << PipeSubscriber {
-         instance
-            ? renderable->GetColor() * instance->GetColor()
-            : renderable->GetColor(),
-         lod.mModel,
-         renderable->GetGeometry(lod),
-         renderable->GetTexture(lod)
-      };
+      // Instances of the same renderable are usually compiled one after
+      // another, so search for a matching batch from the back          
+      auto& batches = cachedPipe.GetValue();
+      const auto texture = renderable->GetTexture(lod);
+      PipeBatch* batch = nullptr;
+      for (auto i = batches.GetCount(); i > 0; --i) {
+         auto& candidate = batches[i - 1];
+         if (candidate.mesh == geometry and candidate.texture == texture) {
+            batch = &candidate;
+            break;
+         }
+      }
+
+      if (not batch) {
+         batches << PipeBatch {geometry, texture};
+         batch = &batches.Last();
+      }
+
+      batch->transforms << lod.mModel;
+      batch->colors << RGBAf {instance
+         ? renderable->GetColor() * instance->GetColor()
+         : renderable->GetColor()};
    }
 }
 
 /// Compile a single light instance                                           
 ///   @attention lights aren't added to scenes that do not have renderables,  
-///      and compiling them relies on the precompiled renderables to hint at  
-///      what depth range is relevant in the scene, so that the shadowmaps    
-///      are packed as tightly as possible                                    
+///      and compiling them relies on the precompiled renderables to cull the 
+///      lights' influence                                                    
 ///   @param light - the light to compile                                     
 ///   @param instance - the instance to compile                               
 ///   @param lod - the lod state to use                                       
@@ -278,10 +568,8 @@ void ASCIILayer::CompileLight(
       lod.Transform();
    }
    else {
-      // Instance available, so do frustum culling                      
-      //TODO lights need a bit more complicated culling
-      //if (instance->Cull(lod))
-      //   return;
+      // Instance available - the light's influence is culled below,    
+      // because the instance's own bounds don't represent it           
       lod.Transform(instance->GetModelTransform(lod));
    }
 
@@ -295,39 +583,211 @@ void ASCIILayer::CompileLight(
          return;
 
       const Mat4 MV = instance
-         ? instance->GetViewTransform(cachedLvl.GetKey())
+         ? instance->GetViewTransform(lod.mLevel)
          : Mat4 {};
+      const Vec3 position = MV.GetPosition();
+      const Vec3 direction = MV.GetView().Normalize();
+
+      // Lights with limited influence are culled, if their volume      
+      // doesn't reach the visible part of the level's content          
+      auto& level = cachedLvl.GetValue();
+      ASCIIBounds influence;
+      if (light->GetBounds(position, direction, influence)) {
+         if (not level.mHasContent or not level.mContent.Intersects(influence))
+            return;
+         if (influence.IsOutside(level.mProjectedView))
+            return;
+      }
 
-      cachedLvl.GetValue().mLights << LightSubscriber {
+      level.mLights << LightSubscriber {
          instance ? light->GetColor() * instance->GetColor()
                   : light->GetColor(),
-         instance ? light->GetProjection(cachedLvl.GetValue().mDepthRange) * MV.Invert()
-                  : light->GetProjection(cachedLvl.GetValue().mDepthRange),
-         MV.GetPosition(),
-         MV.GetView().Normalize(),
-         light->mType
+         position,
+         direction,
+         light->mType,
+         light->GetRange(),
+         light->GetSpread(),
+         light->mShadowmapSize,
+         light,
+         instance
       };
    };
 
    // Cache the instance in the appropriate sequence                    
    if (mStyle & Style::Hierarchical)
-      push_in(mHierarchicalSequence);
+      push_in(GetCompiling().mHierarchicalSequence);
+   else
+      push_in(GetCompiling().mBatchSequence);
+}
+
+/// Fit the shadows of all compiled lights, once all levels are compiled      
+/// Shadowed lights of a level get consecutive shadowmap indices, because     
+/// levels are rendered one after another, and reuse the same shadowmaps      
+void ASCIILayer::CompileShadows() {
+   auto fit = [this](auto& sequence) {
+      for (const auto& job : mJobs) {
+         auto cachedCam = sequence.FindIt(job.mCamera);
+         if (not cachedCam)
+            continue;
+
+         auto cachedLvl = cachedCam.GetValue().FindIt(-job.mLOD.mLevel);
+         if (cachedLvl)
+            CompileShadows(job, cachedLvl.GetValue());
+      }
+   };
+
+   if (mStyle & Style::Hierarchical)
+      fit(GetCompiling().mHierarchicalSequence);
+   else
+      fit(GetCompiling().mBatchSequence);
+}
+
+/// Fit the shadows of all lights of a single compiled level                  
+/// Each shadow covers only the part of the level's content, that the camera  
+/// sees. Its casters are gathered for each light separately - instances the  
+/// camera doesn't see are queried from the instance tree, because they might 
+/// still shadow the visible ones. The depth range is then fitted again, so   
+/// that it starts at the nearest of them                                     
+///   @param job - the camera and level the level was compiled for            
+///   @param cached - [in/out] the compiled level, whose casters are replaced 
+///      by the casters of its shadowed lights                                
+template<class LEVEL>
+void ASCIILayer::CompileShadows(const LevelJob& job, LEVEL& cached) {
+   if (not cached.mHasContent)
+      return;
+
+   // Nothing past the fog is visible, so the far plane is pulled in to 
+   // where the fog ends                                                
+   const auto visible = cached.mContent.Intersect(
+      ASCIIBounds::Frustum(cached.mProjectedView, cached.mFarDepth));
+
+   // The compiled renderables are only candidates, that each light     
+   // picks its own casters from                                        
+   ::std::vector<ShadowCaster> compiled;
+   ::std::unordered_set<InstanceKey, InstanceKey::Hash> compiledKeys;
+   compiled.reserve(cached.mCasters.GetCount());
+   for (const auto& caster : cached.mCasters) {
+      compiled.push_back(caster);
+      if (caster.mInstance)
+         compiledKeys.insert({caster.mRenderable, caster.mInstance});
+   }
+   cached.mCasters.Clear();
+
+   int shadowmaps = 0;
+   for (auto& light : cached.mLights) {
+      // Point lights would need a cubemap, and are left unshadowed.    
+      // Spot lights without range light the whole scene like           
+      // directional ones, so they're projected the same way            
+      Real spread = 0;
+      if (light.type == A::Light::Spot and light.range > 0)
+         spread = light.spread;
+      else if (light.type != A::Light::Directional
+           and light.type != A::Light::Spot)
+         continue;
+
+      if (not light.shadow.Fit(light.position, light.direction, spread, visible, cached.mContent))
+         continue;
+
+      light.firstCaster = cached.mCasters.GetCount();
+      ASCIIBounds casters = cached.mContent;
+      auto cast = [&](const ShadowCaster& caster) {
+         const auto bounds = caster.mMesh->GetBounds().Transform(caster.mTransform);
+         if (not light.shadow.Reaches(bounds))
+            return;
+
+         cached.mCasters << caster;
+         casters = casters.Merge(bounds);
+      };
+
+      for (const auto& caster : compiled)
+         cast(caster);
+
+      mInstanceTree.Query([&light](const ASCIIBounds& bounds) {
+         return not light.shadow.Reaches(bounds);
+      }, [&](size_t index) {
+         const auto& entry = mEntries[index];
+         if (entry.mInstance->GetLevel() != job.mLOD.mLevel
+         or compiledKeys.contains({entry.mRenderable, entry.mInstance}))
+            return;
+
+         LOD lod = job.mLOD;
+         lod.Transform(entry.mInstance->GetModelTransform(lod));
+         const auto geometry = entry.mRenderable->GetGeometry(lod);
+         if (not geometry)
+            return;
+
+         const auto proxy = mInstanceProxies.find({entry.mRenderable, entry.mInstance});
+         const bool still = proxy != mInstanceProxies.end() and proxy->second.mStatic;
+         cast({geometry, lod.mModel, still, entry.mRenderable, entry.mInstance});
+      });
+
+      light.casterCount = cached.mCasters.GetCount() - light.firstCaster;
+      if (light.shadow.Fit(light.position, light.direction, spread, visible, casters))
+         light.shadowmap = shadowmaps++;
+   }
+}
+
+/// Size the layer's buffers and shadowmaps for rendering the published       
+/// scene, so that Render() never has to allocate. Shadowmaps that weren't    
+/// used by the last Render() are forgotten here, too                         
+///   @param config - where to render to                                      
+void ASCIILayer::PrepareBuffers(const RenderConfig& config) const {
+   const int sizex = config.mResolution.x;
+   const int sizey = config.mResolution.y;
+   mImage.Resize(sizex, sizey);
+   mDepth.Resize(sizex, sizey);
+   mCoverage.Resize(sizex, sizey);
+   mScissor = mDepth.GetRect();
+
+   // Forget the shadows of lights, cameras and levels that are gone    
+   ::std::erase_if(mShadowCache, [this](const auto& pair) {
+      return pair.second.mLastUsed != mShadowFrame;
+   });
+
+   auto reserve = [this](const auto& sequence) {
+      for (const auto camera : sequence) {
+         for (auto level : KeepIterator(camera.GetValue())) {
+            const auto& cached = level.GetValue();
+            for (const auto& light : cached.mLights) {
+               if (light.shadowmap < 0)
+                  continue;
+
+               bool dynamic = false;
+               const auto casters = cached.mCasters.GetRaw() + light.firstCaster;
+               for (size_t i = 0; i < light.casterCount; ++i)
+                  dynamic |= not casters[i].mStatic;
+
+               auto& shadow = mShadowCache[{camera.GetKey(), level.GetKey(), light.light, light.instance}];
+               const auto x = static_cast<int>(light.shadowmapSize.x);
+               const auto y = static_cast<int>(light.shadowmapSize.y);
+               if (shadow.mStatic.GetWidth() != x or shadow.mStatic.GetHeight() != y)
+                  shadow.mValid = false;
+
+               shadow.mStatic.Resize(x, y);
+               if (dynamic)
+                  shadow.mDepth.Resize(x, y);
+            }
+         }
+      }
+   };
+
+   if (mStyle & Style::Hierarchical)
+      reserve(GetPublished().mHierarchicalSequence);
    else
-      push_in(mBatchSequence);
+      reserve(GetPublished().mBatchSequence);
 }
 
 /// Render the layer to a specific command buffer and framebuffer             
+///   @attention the layer's buffers must be prepared with PrepareBuffers()   
 ///   @param config - where to render to                                      
 void ASCIILayer::Render(const RenderConfig& config) const {
    LANGULUS(PROFILE);
-   const int sizex = static_cast<int>(GetWindow()->GetSize().x);
-   const int sizey = static_cast<int>(GetWindow()->GetSize().y);
 
-   mImage.Resize(sizex, sizey);
-   mDepth.Resize(sizex, sizey);
-
-   mImage.Fill(" ", Colors::White, Colors::Red);
+   // The image itself isn't cleared - only covered cells are ever      
+   // composited, so clearing the coverage is enough                    
+   mCoverage.Clear();
    mDepth.Fill(config.mClearDepth);
+   ++mShadowFrame;
 
    if (mStyle & Style::Hierarchical)
       RenderHierarchical(config);
@@ -340,25 +800,37 @@ void ASCIILayer::Render(const RenderConfig& config) const {
 ///   @param cfg - render configuration                                       
 void ASCIILayer::RenderBatched(const RenderConfig& cfg) const {
    // Rendering from each custom camera's point of view                 
-   for (const auto camera : mBatchSequence) {
+   for (const auto camera : GetPublished().mBatchSequence) {
       // Draw all relevant levels from the camera's POV                 
       for (auto level : KeepIterator(camera.GetValue())) {
-         const auto projectedView = camera.GetKey()->mProjection
-            * camera.GetKey()->GetViewTransform(level.GetKey()).Invert();
+         const auto& projectedView = level.GetValue().mProjectedView;
+         mScissor = level.GetValue().mScissor;
+         RenderShadows(camera.GetKey(), level.GetKey(), level.GetValue().mLights, level.GetValue().mCasters);
+
+         // Lay down the depth of all batches of the level first, so    
+         // that only the nearest surfaces get shaded afterwards        
+         const bool prepass = mStyle & Style::DepthPrepass;
+         if (prepass) {
+            for (const auto pipeline : level.GetValue().mPipelines) {
+               for (const auto& batch : pipeline.GetValue())
+                  pipeline.GetKey()->RenderDepth(this, projectedView, batch);
+            }
+         }
 
          // Involve all relevant pipelines for that level               
          for (const auto pipeline : level.GetValue().mPipelines) {
-            // Draw all renderables that use that pipeline in their     
-            // current LOD state, from that particular level & POV      
-            for (const auto& instance : pipeline.GetValue())
-               pipeline.GetKey()->Render(this, projectedView, instance, level.GetValue().mLights);
+            // Draw all renderable batches that use that pipeline in    
+            // their current LOD state, from that particular level & POV
+            for (const auto& batch : pipeline.GetValue())
+               pipeline.GetKey()->RenderInstanced(this, projectedView, batch, level.GetValue().mLights, prepass);
 
             // Assemble after everything has been drawn                 
             pipeline.GetKey()->Assemble(this);
          }
 
-         // Clear global depth after rendering each level               
-         mDepth.Fill(cfg.mClearDepth);
+         // Clear global depth after rendering each level, but only     
+         // inside the viewport, because nothing else was touched       
+         mDepth.Fill(mScissor, cfg.mClearDepth);
       }
    }
 }
@@ -368,11 +840,12 @@ void ASCIILayer::RenderBatched(const RenderConfig& cfg) const {
 ///   @param cfg - render configuration                                       
 void ASCIILayer::RenderHierarchical(const RenderConfig& cfg) const {
    // Rendering from each custom camera's point of view                 
-   for (const auto camera : mHierarchicalSequence) {
+   for (const auto camera : GetPublished().mHierarchicalSequence) {
       // Draw all relevant levels from the camera's POV                 
       for (auto level : KeepIterator(camera.GetValue())) {
-         const auto projectedView = camera.GetKey()->mProjection
-            * camera.GetKey()->GetViewTransform(level.GetKey()).Invert();
+         const auto& projectedView = level.GetValue().mProjectedView;
+         mScissor = level.GetValue().mScissor;
+         RenderShadows(camera.GetKey(), level.GetKey(), level.GetValue().mLights, level.GetValue().mCasters);
 
          // Render all relevant pipe-renderable pairs for that level    
          for (const auto& instance : level.GetValue().mPipelines) {
@@ -382,8 +855,91 @@ void ASCIILayer::RenderHierarchical(const RenderConfig& cfg) const {
             instance.GetKey()->Assemble(this);
          }
 
-         // Clear depth after rendering each level                      
-         mDepth.Fill(cfg.mClearDepth);
+         // Clear depth after rendering each level, but only inside the 
+         // viewport, because nothing else was touched                  
+         mDepth.Fill(mScissor, cfg.mClearDepth);
+      }
+   }
+}
+
+/// Update the shadowmaps of all shadowed lights in a level, before it is     
+/// rendered. Static casters are redrawn only if they changed, or if the      
+/// cached shadow projection no longer covers the one fitted for this frame   
+///   @param camera - the camera the level is rendered from                   
+///   @param level - the level                                                
+///   @param lights - the lights of the level                                 
+///   @param all - the shadow casters of all lights of the level, each light  
+///      draws only its own range of them                                     
+void ASCIILayer::RenderShadows(
+   const ASCIICamera* camera, Level level,
+   const TMany<LightSubscriber>& lights,
+   const TMany<ShadowCaster>& all
+) const {
+   mShadowmaps.clear();
+
+   for (const auto& light : lights) {
+      if (light.shadowmap < 0)
+         continue;
+
+      // Hash the static casters, so that changes among them are        
+      // detected                                                       
+      const auto casters = ::std::span {all.GetRaw() + light.firstCaster, light.casterCount};
+      size_t hash = 0;
+      bool dynamic = false;
+      for (const auto& caster : casters) {
+         if (not caster.mStatic) {
+            dynamic = true;
+            continue;
+         }
+
+         const auto a = reinterpret_cast<size_t>(caster.mMesh);
+         const auto b = ::std::hash<::std::string_view> {}({
+            reinterpret_cast<const char*>(&caster.mTransform), sizeof(Mat4)});
+         hash ^= a + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+         hash ^= b + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+      }
+
+      auto& shadow = mShadowCache[{camera, level, light.light, light.instance}];
+      shadow.mLastUsed = mShadowFrame;
+      LANGULUS_ASSUME(DevAssumes,
+         mShadowmaps.size() == static_cast<size_t>(light.shadowmap),
+         "Shadowmap indices must be consecutive");
+      mShadowmaps.push_back(&shadow);
+
+      // Refit only if the cached projection doesn't cover the new one  
+      const auto sizex = static_cast<int>(light.shadowmapSize.x);
+      const auto sizey = static_cast<int>(light.shadowmapSize.y);
+      if (not shadow.mValid
+      or not shadow.mFrustum.Contains(light.shadow)
+      or shadow.mStatic.GetWidth()  != sizex
+      or shadow.mStatic.GetHeight() != sizey) {
+         shadow.mFrustum = light.shadow.Grow(ShadowMargin);
+         shadow.mValid = false;
+      }
+
+      // Redraw the static casters only if they changed                 
+      if (not shadow.mValid or shadow.mCasters != hash) {
+         shadow.mStatic.Resize(sizex, sizey);
+         shadow.mStatic.Fill(1);
+         for (const auto& caster : casters) {
+            if (caster.mStatic)
+               ASCIIPipeline::RenderShadow(shadow.mFrustum, shadow.mStatic, caster.mTransform, *caster.mMesh);
+         }
+
+         shadow.mCasters = hash;
+         shadow.mValid = true;
+         ++shadow.mVersion;
+      }
+
+      // Draw the dynamic casters over the static depth                 
+      shadow.mDynamic = dynamic;
+      if (dynamic) {
+         shadow.mDepth.Resize(sizex, sizey);
+         shadow.mDepth.Copy(shadow.mStatic);
+         for (const auto& caster : casters) {
+            if (not caster.mStatic)
+               ASCIIPipeline::RenderShadow(shadow.mFrustum, shadow.mDepth, caster.mTransform, *caster.mMesh);
+         }
       }
    }
 }
@@ -399,3 +955,12 @@ auto ASCIILayer::GetStyle() const noexcept -> Style {
 auto ASCIILayer::GetWindow() const noexcept -> const A::Window* {
    return mProducer->GetWindow();
 }
+
+/// Get the memory allocated for the layer's buffers and cached shadowmaps    
+///   @return the size in bytes                                               
+auto ASCIILayer::GetBufferBytes() const noexcept -> size_t {
+   size_t bytes = mImage.GetBytes() + mDepth.GetBytes() + mCoverage.GetBytes();
+   for (const auto& shadow : mShadowCache)
+      bytes += shadow.second.mStatic.GetBytes() + shadow.second.mDepth.GetBytes();
+   return bytes;
+}
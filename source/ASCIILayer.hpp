@@ -9,33 +9,80 @@
 #include "ASCIICamera.hpp"
 #include "ASCIIRenderable.hpp"
 #include "ASCIILight.hpp"
+#include "inner/ASCIIBVH.hpp"
 #include <Langulus/Anyness/TSet.hpp>
 #include <Langulus/Flow/Factory.hpp>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 
 struct RenderConfig {
    RGBAf mClearColor;
    float mClearDepth;
+   // Window size at the time the scene was compiled, in cells          
+   Scale2i mResolution;
+   // The frame the scene was compiled in, and the seconds it took      
+   uint64_t mFrame = 0;
+   Real mGenerateTime = 0;
+};
+
+/// A renderable instance, that casts shadows in a level                      
+struct ShadowCaster {
+   const ASCIIGeometry* mMesh;
+   Mat4 mTransform;
+   // Whether the instance hasn't moved since the last frame, so that   
+   // its shadow can be cached                                          
+   bool mStatic;
+   // The renderable and instance the caster was compiled from          
+   const ASCIIRenderable* mRenderable;
+   const A::Instance* mInstance;
 };
 
 /// Each cached level contains something renderable. Each level contains      
 /// a set of relevant pipelines, and each of these pipelines draws a list of  
-/// precompiled renderables. Each level contains also a list of precompiled   
-/// lights and a depth range for drawing shadowmaps tightly.                  
+/// precompiled renderables, batched by geometry and texture. Each level      
+/// contains also a list of precompiled lights, whose shadows are fitted to   
+/// the visible content of the level, and the casters of those shadows.       
 struct CachedLevelBatched {
    TMany<LightSubscriber> mLights;
-   Range1 mDepthRange = {0, 1000};
-   TUnorderedMap<const ASCIIPipeline*, TMany<PipeSubscriber>> mPipelines;
+   Mat4 mProjectedView;
+   // Cells of the camera's viewport                                    
+   ASCIIRect mScissor;
+   TUnorderedMap<const ASCIIPipeline*, TMany<PipeBatch>> mPipelines;
+   // Shadow casters of each shadowed light, in the range given by the  
+   // light. Until the shadows are fitted, all compiled renderables     
+   TMany<ShadowCaster> mCasters;
+   // Bounds of all compiled renderables, used to cull lights           
+   ASCIIBounds mContent;
+   bool mHasContent = false;
+   // Farthest depth, at which any compiled renderable isn't completely 
+   // covered by fog. Shadows are fitted only up to it                  
+   Real mFarDepth = 0;
 };
 
 /// Each cached level contains something renderable. Each level contains      
 /// a a list if pipe-renderable pairs that have to be drawn in the order they 
-/// appear. Each level contains also a list of precompiled lights and a depth 
-/// range for drawing shadowmaps tightly.                                     
+/// appear. Each level contains also a list of precompiled lights, whose      
+/// shadows are fitted to the visible content of the level, and the casters   
+/// of those shadows.                                                         
 struct CachedLevelHierarchical {
    TMany<LightSubscriber> mLights;
-   Range1 mDepthRange = {0, 1000};
+   Mat4 mProjectedView;
+   // Cells of the camera's viewport                                    
+   ASCIIRect mScissor;
    TMany<TPair<const ASCIIPipeline*, PipeSubscriber>> mPipelines;
+   // Shadow casters of each shadowed light, in the range given by the  
+   // light. Until the shadows are fitted, all compiled renderables     
+   TMany<ShadowCaster> mCasters;
+   // Bounds of all compiled renderables, used to cull lights           
+   ASCIIBounds mContent;
+   bool mHasContent = false;
+   // Farthest depth, at which any compiled renderable isn't completely 
+   // covered by fog. Shadows are fitted only up to it                  
+   Real mFarDepth = 0;
 };
 
 /// For each enabled camera, there exist N cached levels optimized for batch  
@@ -46,6 +93,131 @@ using BatchSequence = TUnorderedMap<const ASCIICamera*, TOrderedMap<Level, Cache
 /// descending hierarchical order                                             
 using HierarchicalSequence = TUnorderedMap<const ASCIICamera*, TOrderedMap<Level, CachedLevelHierarchical>>;
 
+/// A compiled snapshot of the layer's scene. It holds everything needed to   
+/// render a frame, without touching cameras, instances or any other units,   
+/// so that it can be rendered on another thread, while the next one is      
+/// being compiled                                                            
+struct CompiledScene {
+   // Cached levels, used when rendering batched layers                 
+   BatchSequence mBatchSequence;
+   // Cached levels, used when rendering hierarchical layers            
+   HierarchicalSequence mHierarchicalSequence;
+   // Number of renderable instances tested for each camera and level,  
+   // and how many of them ended up in a pipeline                       
+   size_t mInstancesConsidered = 0;
+   size_t mInstancesDrawn = 0;
+
+   void Clear() {
+      mBatchSequence.Clear();
+      mHierarchicalSequence.Clear();
+      mInstancesConsidered = 0;
+      mInstancesDrawn = 0;
+   }
+
+   void Reset() {
+      mBatchSequence.Reset();
+      mHierarchicalSequence.Reset();
+   }
+};
+
+
+/// A renderable or light instance, flattened from the scene in the order it  
+/// has to be compiled. Exactly one of mRenderable and mLight is set          
+struct LayerEntry {
+   const ASCIIRenderable* mRenderable;
+   const ASCIILight* mLight;
+   const A::Instance* mInstance;
+};
+
+/// An entry that passed culling, along with its transformed LOD state        
+struct CulledEntry {
+   const LayerEntry* mEntry;
+   LOD mLOD;
+};
+
+/// A single camera and level pair to compile, along with the LOD state       
+/// containing the camera's view and projection for that level. The projected 
+/// view is computed once per frame, and is shared by culling and rendering   
+struct LevelJob {
+   const ASCIICamera* mCamera;
+   LOD mLOD;
+   Mat4 mProjectedView;
+};
+
+/// A chunk of potentially visible entries of a single job, culled by a       
+/// single compilation task                                                   
+struct LevelTask {
+   size_t mJob;
+   size_t mBegin;
+   size_t mEnd;
+};
+
+/// Identifies an instanced renderable inside the layer's instance tree       
+struct InstanceKey {
+   const ASCIIRenderable* mRenderable;
+   const A::Instance* mInstance;
+
+   bool operator == (const InstanceKey&) const noexcept = default;
+
+   struct Hash {
+      size_t operator() (const InstanceKey& key) const noexcept {
+         const auto a = reinterpret_cast<size_t>(key.mRenderable);
+         const auto b = reinterpret_cast<size_t>(key.mInstance);
+         return a ^ (b + 0x9e3779b9 + (a << 6) + (a >> 2));
+      }
+   };
+};
+
+/// An instanced renderable's proxy in the instance tree                      
+struct InstanceProxy {
+   int mProxy = ASCIIBVH::Null;
+   // Last Generate() in which the instance was seen                    
+   uint32_t mGeneration = 0;
+   // Model transformation at that time                                 
+   Mat4 mModel;
+   // Whether the model transformation didn't change since the previous 
+   // Generate()                                                        
+   bool mStatic = false;
+};
+
+/// Identifies a light's shadow in a camera's level, between frames           
+struct ShadowKey {
+   const ASCIICamera* mCamera;
+   Level mLevel;
+   const ASCIILight* mLight;
+   const A::Instance* mInstance;
+
+   bool operator < (const ShadowKey& rhs) const noexcept {
+      return ::std::tie(mCamera, mLevel, mLight, mInstance)
+           < ::std::tie(rhs.mCamera, rhs.mLevel, rhs.mLight, rhs.mInstance);
+   }
+};
+
+/// A light's shadowmap, kept between frames. Static casters are drawn only   
+/// when they, or the shadow projection, change. Dynamic casters are drawn    
+/// each frame over a copy of the static depth                                
+struct CachedShadow {
+   // The projection both maps are drawn with                           
+   ShadowFrustum mFrustum;
+   // Hash of the static casters in mStatic                             
+   size_t mCasters = 0;
+   // Incremented each time mStatic is drawn                            
+   size_t mVersion = 0;
+   bool mValid = false;
+   // Whether there are dynamic casters this frame                      
+   bool mDynamic = false;
+   // Last frame the shadow was used in                                 
+   uint64_t mLastUsed = 0;
+   // Depth of the static casters                                       
+   ASCIIBuffer<float> mStatic;
+   // Depth of the static and dynamic casters                           
+   ASCIIBuffer<float> mDepth;
+
+   auto GetDepth() noexcept -> ASCIIBuffer<float>& {
+      return mDynamic ? mDepth : mStatic;
+   }
+};
+
 
 ///                                                                           
 ///   Graphics layer unit                                                     
@@ -77,19 +249,57 @@ protected:
    // List of lights                                                    
    TFactory<ASCIILight> mLights;
 
-   // The compiled batch render sequence                                
-   BatchSequence mBatchSequence;
-   // The compiled hierarchical render sequence                         
-   HierarchicalSequence mHierarchicalSequence;
+   // Compiled scenes - one is compiled by Generate(), while the other  
+   // is rendered by Render(). Publish() swaps them                     
+   CompiledScene mScenes[2];
+   // Index of the published scene, the other one is being compiled     
+   int mPublished = 0;
+
+   // The scene, flattened for compilation on each Generate()           
+   ::std::vector<LayerEntry> mEntries;
+   // Camera and level pairs compiled by the last Generate()            
+   ::std::vector<LevelJob> mJobs;
+   // Number of entries culled by a single compilation task             
+   static constexpr size_t CompileChunkSize = 256;
+
+   // Broad phase for culling instanced renderables, refitted on each   
+   // Generate(). Only entries with known bounds are in it - the rest   
+   // are tested for every camera and level                             
+   ASCIIBVH mInstanceTree;
+   ::std::unordered_map<InstanceKey, InstanceProxy, InstanceKey::Hash> mInstanceProxies;
+   uint32_t mGeneration = 0;
+   // Indices of entries that aren't in the instance tree, in order     
+   ::std::vector<size_t> mUnbounded;
+
+   // Sorted and disjoint level ranges, that contain any renderables    
+   ::std::vector<LevelRange> mOccupancy;
 
    // Depth buffer                                                      
    mutable ASCIIBuffer<float> mDepth;
+   // Cells of the viewport of the level being rendered. Pipelines draw 
+   // only inside it                                                    
+   mutable ASCIIRect mScissor;
+
+   // Shadowmaps of all lights, cached between frames                   
+   mutable ::std::map<ShadowKey, CachedShadow> mShadowCache;
+   // Shadowmaps of the level being rendered, indexed by the lights'    
+   // LightSubscriber::shadowmap                                        
+   mutable ::std::vector<CachedShadow*> mShadowmaps;
+   // Incremented on each Render(), used to forget unused shadowmaps    
+   mutable uint64_t mShadowFrame = 0;
+   // How much a shadow projection is grown when fitted, so that it     
+   // can be reused while the content moves a bit                       
+   static constexpr Real ShadowMargin = 0.25;
 
    // The final, combined rendered layer image, after all pipelines,    
    // texturization and illumination. All layer's images are later      
    // blended together into the final ASCIIRenderer's backbuffer        
    mutable ASCIIImage mImage;
 
+   // Which cells of mImage were drawn this frame. Produced while       
+   // assembling pipelines, used for compositing only covered cells     
+   mutable ASCIICoverage mCoverage;
+
 
    /// The layer style determines how the scene will be compiled              
    /// Combine these flags to configure the layer to your needs               
@@ -122,6 +332,16 @@ protected:
       // before committing them for rendering                           
       Sorted = 4,
 
+      // If enabled, the layer is alpha-blended over the layers before  
+      // it when compositing, instead of overwriting their cells        
+      Blended = 8,
+
+      // If enabled, batched layers draw the depth of all renderables   
+      // of a level first, and then shade only the nearest surfaces.    
+      // Worth it when shading is expensive, and there's a lot of       
+      // overdraw, for example in scenes with many lights               
+      DepthPrepass = 16,
+
       // The default visual layer style                                 
       Default = Batched | Multilevel
    };
@@ -133,23 +353,36 @@ public:
 
    void Create(Verb&);
    void Generate();
+   void Publish();
+   void PrepareBuffers(const RenderConfig&) const;
    void Render(const RenderConfig&) const;
    void Teardown();
 
    auto GetStyle()  const noexcept -> Style;
    auto GetWindow() const noexcept -> const A::Window*;
+   auto GetBufferBytes() const noexcept -> size_t;
 
 private:
+   auto GetCompiling() noexcept -> CompiledScene&;
+   auto GetPublished() const noexcept -> const CompiledScene&;
+
    void CompileCameras();
 
    void CompileLevels();
-   void CompileLevelBatched(const ASCIICamera&, Level);
-   void CompileLevelHierarchical(const ASCIICamera&, Level);
+   void GatherEntries();
+   void GatherThing(const Thing*);
+   void RefitInstances();
+   void CompileOccupancy();
+   bool IsOccupied(Level) const;
+   bool CullEntry(const LayerEntry&, LOD&) const;
 
-   void CompileThing(const Thing*, LOD&, const ASCIICamera&);
-   void CompileInstance(const ASCIIRenderable*, const A::Instance*, LOD&, const ASCIICamera&);
+   void CompileInstance(const ASCIIRenderable*, const A::Instance*, LOD&, const LevelJob&);
    void CompileLight(const ASCIILight*, const A::Instance*, LOD&, const ASCIICamera&);
+   void CompileShadows();
+   template<class LEVEL>
+   void CompileShadows(const LevelJob&, LEVEL&);
 
    void RenderBatched(const RenderConfig&) const;
    void RenderHierarchical(const RenderConfig&) const;
+   void RenderShadows(const ASCIICamera*, Level, const TMany<LightSubscriber>&, const TMany<ShadowCaster>&) const;
 };
@@ -30,24 +30,56 @@ auto ASCIILight::GetColor() const -> RGBA {
    return *mColor;
 }
 
-/// The projection associated with the light. Depends on the type of light:   
-///   - directional lights use an orthographic projection                     
-///   - spot lights use a perspective projection with custom FOV              
-///   - point lights use a 90 degree FOV projection that is applied to each   
-///     side of a shadow cubemap                                              
-///   - domain lights aren't projected - they're drawn into a volume          
-///   @return the projection matrix                                           
-auto ASCIILight::GetProjection(Range1 depth) const -> Mat4 {
-   switch (mType) {
-   case Type::Directional:
-      return A::Matrix::Orthographic<Real>(mShadowmapSize.x, mShadowmapSize.y, depth.mMin, depth.mMax);
-   case Type::Point:
-      return A::Matrix::PerspectiveFOV<Real>(90_deg, 1, depth.mMin, depth.mMax);
-   case Type::Spot:
-      return A::Matrix::PerspectiveFOV<Real>(mSpotlightSize, 1, depth.mMin, depth.mMax);
-   case Type::Domain:
-      return {};
+/// Get the radius of influence                                               
+///   @return the radius, or zero if the light is unbounded                   
+auto ASCIILight::GetRange() const -> Real {
+   if (mType != Type::Point and mType != Type::Spot)
+      return 0;
+   return ::std::max(*mRange, Real {0});
+}
+
+/// Get the cosine of half the spot light cone angle                          
+///   @return the cosine, or -1 if the light isn't a spot light               
+auto ASCIILight::GetSpread() const -> Real {
+   if (mType != Type::Spot)
+      return -1;
+   return ::std::cos(mSpotlightSize.GetRadians() / 2);
+}
+
+/// Get the bounds of the light's influence volume - a sphere for point       
+/// lights, and a cone for spot lights. Directional and domain lights, as     
+/// well as lights without range, reach everything                            
+///   @param position - the light position in world space                     
+///   @param direction - the light direction in world space, pointing         
+///      towards the light, as used when shading                              
+///   @param result - [out] the influence bounds                              
+///   @return false if the light is unbounded                                 
+bool ASCIILight::GetBounds(
+   const Vec3& position, const Vec3& direction, ASCIIBounds& result
+) const {
+   const auto range = GetRange();
+   if (range <= 0)
+      return false;
+
+   const Vec3 radius {range, range, range};
+   const auto half = mSpotlightSize.GetRadians() / 2;
+   if (mType == Type::Point or half >= 1.5_real) {
+      // Wide cones aren't worth fitting, just use the sphere           
+      result = {position - radius, position + radius};
+      return true;
    }
+
+   // Bound the apex and the disc at the base of the cone               
+   const Vec3 axis = direction * -1;
+   const Vec3 base = position + axis * range;
+   const auto discRadius = range * ::std::tan(half);
+   const Vec3 disc {
+      discRadius * ::std::sqrt(::std::max(Real {0}, 1 - axis.x * axis.x)),
+      discRadius * ::std::sqrt(::std::max(Real {0}, 1 - axis.y * axis.y)),
+      discRadius * ::std::sqrt(::std::max(Real {0}, 1 - axis.z * axis.z))
+   };
+   result = ASCIIBounds {position, position}.Merge({base - disc, base + disc});
+   return true;
 }
 
 /// Called on environment change                                              
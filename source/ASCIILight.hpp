@@ -7,6 +7,7 @@
 ///                                                                           
 #pragma once
 #include "Common.hpp"
+#include "inner/ASCIIBVH.hpp"
 
 
 ///                                                                           
@@ -26,12 +27,17 @@ protected:
    TRange<Level> mLevelRange;
    Scale2 mShadowmapSize = {64, 64};
    Degrees mSpotlightSize = 90;
+   // Radius of influence for point and spot lights. Zero means that    
+   // the light reaches everything, and isn't attenuated                
+   RTTI::Tag<Pin<Real>, Traits::Size> mRange = 0;
 
 public:
    ASCIILight(ASCIILayer*, const Many&);
 
    auto GetColor() const -> RGBA;
-   auto GetProjection(Range1 depth) const -> Mat4;
+   auto GetRange() const -> Real;
+   auto GetSpread() const -> Real;
+   bool GetBounds(const Vec3&, const Vec3&, ASCIIBounds&) const;
 
    void Refresh();
    void Teardown();
@@ -6,7 +6,10 @@
 /// SPDX-License-Identifier: GPL-3.0-or-later                                 
 ///                                                                           
 #include "ASCII.hpp"
+#include <algorithm>
 #include <bitset>
+#include <limits>
+#include <string_view>
 
 
 /// Descriptor constructor                                                    
@@ -39,23 +42,120 @@ ASCIIPipeline::ASCIIPipeline(ASCIIRenderer* producer, const Many& descriptor)
    }
 }
 
-/// Resize the pipeline's internal buffer                                     
+/// Clear the pipeline's internal buffers, for rendering a new frame          
 ///   @param color - uniform color value                                      
 ///   @param depth - uniform depth value                                      
-void ASCIIPipeline::Clear(const RGBAf& color, float depth) {
+///   @param frame - the renderer frame that is about to be rendered, as in   
+///      RenderConfig::mFrame - the renderer's own counter runs ahead of it   
+///      in threaded mode                                                     
+void ASCIIPipeline::Clear(const RGBAf& color, float depth, uint64_t frame) {
    mBuffer.Fill(color);
    mDepth.Fill(depth);
+   mCoverage.Clear();
+   mStats = {};
+   mFrame = frame;
+
+   // Forget baked lighting, that wasn't used in the last frame         
+   ::std::erase_if(mBaked, [frame](const auto& pair) {
+      return pair.second.mLastUsed + 1 < frame;
+   });
+}
+
+/// Forget lighting baked for geometry, that was evicted                      
+///   @attention must not be called while the pipeline is rendering           
+///   @param geometries - versions of the evicted geometry                    
+void ASCIIPipeline::ForgetBaked(const ::std::vector<uint64_t>& geometries) {
+   if (geometries.empty())
+      return;
+
+   ::std::erase_if(mBaked, [&geometries](const auto& pair) {
+      return ::std::find(geometries.begin(), geometries.end(),
+         pair.first.mGeometry) != geometries.end();
+   });
 }
 
 /// Resize the pipeline's internal buffer                                     
-///   @param x - buffer width                                                 
-///   @param y - buffer height                                                
+/// The buffer has the style's resolution, reduced by the resolution scale    
+///   @param x - layer width, in cells                                        
+///   @param y - layer height, in cells                                       
 void ASCIIPipeline::Resize(int x, int y) {
-   x *= mBufferScale.x;
-   y *= mBufferScale.y;
+   mCells = {x, y};
+   x = ::std::max(1, static_cast<int>(::std::ceil(x * mBufferScale.x * mResolutionScale)));
+   y = ::std::max(1, static_cast<int>(::std::ceil(y * mBufferScale.y * mResolutionScale)));
 
    mBuffer.Resize(x, y);
    mDepth.Resize(x, y);
+   mCoverage.Resize(x, y);
+}
+
+/// Set the fraction of the style's resolution, that the pipeline renders at  
+/// It can go below one pixel per cell, in which case Assemble stretches the  
+/// pixels over multiple cells. Takes effect on the next Resize()             
+///   @param scale - the fraction, clamped to the supported range             
+void ASCIIPipeline::SetResolutionScale(Real scale) noexcept {
+   const Real lowest = MinPixelsPerCell / ::std::min(mBufferScale.x, mBufferScale.y);
+   mResolutionScale = ::std::clamp(scale, lowest, Real {1});
+}
+
+/// Get the fraction of the style's resolution, that the pipeline renders at  
+///   @return the resolution scale                                            
+auto ASCIIPipeline::GetResolutionScale() const noexcept -> Real {
+   return mResolutionScale;
+}
+
+/// Get the time spent rendering and assembling since the last Clear()        
+///   @return the time in seconds                                             
+auto ASCIIPipeline::GetRenderTime() const noexcept -> Real {
+   return mStats.mRenderTime + mStats.mAssembleTime;
+}
+
+/// Get the work done since the last Clear()                                  
+///   @return the statistics                                                  
+auto ASCIIPipeline::GetStatistics() const noexcept -> const ASCIIPipelineStats& {
+   return mStats;
+}
+
+/// Get the memory allocated for the pipeline's intermediate buffers          
+///   @return the size in bytes                                               
+auto ASCIIPipeline::GetBufferBytes() const noexcept -> size_t {
+   return mBuffer.GetBytes() + mDepth.GetBytes() + mCoverage.GetBytes()
+      + mClipSpace.capacity() * sizeof(Vec4)
+      + mVertexLight.capacity() * sizeof(RGBAf);
+}
+
+/// Get the depth, past which fog completely covers everything drawn by the   
+/// pipeline. This is the fog equation in RasterizeTriangle, solved for a fog 
+/// of one                                                                    
+///   @return the depth in normalized device coordinates, or 1 if the         
+///      pipeline doesn't use fog                                             
+auto ASCIIPipeline::GetFogDepth() const noexcept -> Real {
+   if (not mFog)
+      return 1;
+   return 1 - mFogRange.GetMin() / 1000;
+}
+
+/// Check if a box is so far, that it would be drawn only in fog color        
+/// Depth is linear along the box, so its nearest point is one of the corners 
+///   @param bounds - the box, in world space                                 
+///   @param pv - the projection-view matrix                                  
+///   @return true if the whole box is past the fog depth                     
+bool ASCIIPipeline::IsFogged(const ASCIIBounds& bounds, const Mat4& pv) const noexcept {
+   const auto fogged = GetFogDepth();
+   if (fogged >= 1)
+      return false;
+
+   for (int i = 0; i < 8; ++i) {
+      const Vec4 p = pv * Vec4 {
+         i & 1 ? bounds.mMax.x : bounds.mMin.x,
+         i & 2 ? bounds.mMax.y : bounds.mMin.y,
+         i & 4 ? bounds.mMax.z : bounds.mMin.z,
+         1
+      };
+
+      if (p.w <= 0 or p.z < fogged * p.w)
+         return false;
+   }
+   return true;
 }
 
 /// Draw a single renderable (used in hierarchical drawing)                   
@@ -70,13 +170,35 @@ void ASCIIPipeline::Render(
    const TMany<LightSubscriber>& lights
 ) const {
    LANGULUS(PROFILE);
+   const RenderTimer timer {mStats.mRenderTime};
    if (not sub.mesh)
       return;
 
-   PipelineState ps {layer, mBuffer.GetView().GetScale(), pv, sub, lights};
+   PipelineState ps {layer, GetViewport(layer), pv, sub, lights, mFrame};
    RasterizeMesh(ps);
 }
 
+/// Get the part of the render buffer, that the layer's current viewport      
+/// covers. Everything is rasterized relative to it, so normalized device     
+/// coordinates map to it, and clipping confines triangles to it. These are   
+/// the pixels, whose cells are inside the viewport, see GetCellX/Y           
+///   @param layer - the layer that we're rendering to                        
+///   @return the viewport, in pixels                                         
+auto ASCIIPipeline::GetViewport(const ASCIILayer* layer) const noexcept -> ASCIIRect {
+   const auto& cells = layer->mScissor;
+   const int w = mBuffer.GetWidth();
+   const int h = mBuffer.GetHeight();
+   auto toPixel = [](int cell, int pixels, int count) {
+      return (cell * pixels + count - 1) / count;
+   };
+
+   const int x0 = toPixel(cells.mX, w, mCells.x);
+   const int y0 = toPixel(cells.mY, h, mCells.y);
+   const int x1 = toPixel(cells.mX + cells.mWidth,  w, mCells.x);
+   const int y1 = toPixel(cells.mY + cells.mHeight, h, mCells.y);
+   return ASCIIRect {x0, y0, x1 - x0, y1 - y0}.Clip(w, h);
+}
+
 /// Credit: https://github.com/Gaukler/Software-Rasterizer                    
 /// However the mentioned code clips in NDC space, which presumably works     
 /// only if there's no chance at anything getting behind the camera.          
@@ -129,17 +251,24 @@ std::vector<Vec4> ClipLine(const std::vector<Vec4>& vertices) {
 }
 
 /// Clip a triangle depending on how many vertices are in viewport            
-///   @param MVP - model*view*projection matrix                               
-///   @param triangle - the triangle to clip                                  
+///   @param triangle - the triangle to clip, already in clip space           
 ///   @param rasterizer - rasterizer to use                                   
-void ASCIIPipeline::ClipTriangle(
-   const Mat4& MVP, const ASCIIGeometry::Vertex* triangle, auto&& rasterizer
-) const {
-   // Transform to viewspace                                            
-   std::vector<Vec4> points;
-   points.emplace_back(MVP * triangle[0].mPos);
-   points.emplace_back(MVP * triangle[1].mPos);
-   points.emplace_back(MVP * triangle[2].mPos);
+void ASCIIPipeline::ClipTriangle(const Vec4* triangle, auto&& rasterizer) const {
+   auto isInside = [](const Vec4& p) {
+      return p.z > -p.w and p.z < p.w;
+   };
+
+   if (isInside(triangle[0]) and isInside(triangle[1]) and isInside(triangle[2])) {
+      // Nothing to clip - produce the same vertex order as ClipLine    
+      rasterizer(Triangle4 {
+         triangle[1] / triangle[1].w,
+         triangle[2] / triangle[2].w,
+         triangle[0] / triangle[0].w
+      });
+      return;
+   }
+
+   std::vector<Vec4> points {triangle[0], triangle[1], triangle[2]};
 
    // Clip                                                              
    //points = ClipLine<0>(points);
@@ -159,42 +288,328 @@ void ASCIIPipeline::ClipTriangle(
       rasterizer(Triangle4 {points[0], points[i], points[i + 1]});
 }
 
-/// Rasterize a single triangle                                               
-///   @tparam LIT - whether or not to calculate lights and speculars          
-///   @tparam DEPTH - whether or not to perform depth test and write depth    
-///   @tparam SMOOTH - interpolate normals/colors inside trianlges            
-///   @tparam FOG - apply fog                                                 
-///   @tparam COLORIZE - apply vertex colors                                  
-///   @tparam SHADOWED - apply shadowmaps                                     
+/// Calculate the light a surface point receives from a single light          
+/// Lights with range are attenuated linearly, and spot lights with range     
+/// light only the inside of their cone, matching their influence volume      
+///   @param light - the light                                                
+///   @param n - the surface normal in world space                            
+///   @param p - the surface position in world space                          
+///   @return the received light color                                        
+RGBAf Illuminate(const LightSubscriber& light, const Vec3& n, const Vec3& p) {
+   switch (light.type) {
+   case A::Light::Directional:
+      // Direction is taken from the light instance                     
+      return light.color * n.Dot(light.direction);
+   case A::Light::Spot: {
+      if (light.range <= 0) {
+         // Unbounded spot lights act like directional ones             
+         return light.color * n.Dot(light.direction);
+      }
+
+      const Vec3 toLight = light.position - p;
+      const Real distance = toLight.Length();
+      if (distance >= light.range or distance <= 0
+      or (toLight / distance).Dot(light.direction) < light.spread)
+         return 0;
+      return light.color * n.Dot(light.direction) * (1 - distance / light.range);
+   }
+   case A::Light::Point: {
+      // Direction is relative to light position                        
+      const Vec3 toLight = light.position - p;
+      if (light.range <= 0)
+         return light.color * n.Dot(toLight.Normalize());
+
+      const Real distance = toLight.Length();
+      if (distance >= light.range or distance <= 0)
+         return 0;
+      return light.color * n.Dot(toLight / distance) * (1 - distance / light.range);
+   }
+   case A::Light::Domain:
+      TODO();
+   }
+   return 0;
+}
+
+/// Fit a light's shadow projection around the region it has to shadow        
+/// The map covers only the part of the receivers, that the light reaches,    
+/// while the depth range starts at the nearest caster, so that anything      
+/// between the light and the receivers still casts shadows                   
+///   @param position - the light position                                    
+///   @param direction - the light direction, pointing towards the light      
+///   @param spread - cosine of half the spot cone, zero if not perspective   
+///   @param receivers - the visible content, that receives shadows           
+///   @param casters - all content that might cast shadows                    
+///   @return false if the light can't shadow any of the receivers            
+bool ShadowFrustum::Fit(
+   const Vec3& position, const Vec3& direction, Real spread,
+   const ASCIIBounds& receivers, const ASCIIBounds& casters
+) noexcept {
+   if (receivers.IsEmpty())
+      return false;
+
+   mOrigin = position;
+   mForward = (direction * -1).Normalize();
+   const Vec3 helper = ::std::abs(mForward.y) < 0.99_real
+      ? Vec3 {0, 1, 0} : Vec3 {1, 0, 0};
+   mRight = helper.Cross(mForward).Normalize();
+   mUp = mForward.Cross(mRight);
+   mPerspective = spread > 0 and spread < 1;
+
+   // Spot lights never reach outside their cone                        
+   const Real limit = mPerspective
+      ? ::std::sqrt(1 - spread * spread) / spread
+      : ::std::numeric_limits<Real>::max();
+
+   auto corner = [](const ASCIIBounds& box, int i) {
+      return Vec3 {
+         i & 1 ? box.mMax.x : box.mMin.x,
+         i & 2 ? box.mMax.y : box.mMin.y,
+         i & 4 ? box.mMax.z : box.mMin.z
+      };
+   };
+
+   Vec2 lo {limit, limit};
+   Vec2 hi {-limit, -limit};
+   Real far = ::std::numeric_limits<Real>::lowest();
+   bool inFront = false;
+   for (int i = 0; i < 8; ++i) {
+      const Vec3 d = corner(receivers, i) - mOrigin;
+      const Real z = d.Dot(mForward);
+      Vec2 xy {d.Dot(mRight), d.Dot(mUp)};
+      far = ::std::max(far, z);
+
+      if (mPerspective) {
+         if (z <= 0) {
+            // Receivers wrap around the apex, so the whole cone is used
+            lo = {-limit, -limit};
+            hi = { limit,  limit};
+            continue;
+         }
+
+         xy /= z;
+         inFront = true;
+      }
+
+      lo = {::std::min(lo.x, xy.x), ::std::min(lo.y, xy.y)};
+      hi = {::std::max(hi.x, xy.x), ::std::max(hi.y, xy.y)};
+   }
+
+   if (mPerspective) {
+      if (not inFront)
+         return false;
+
+      lo = {::std::max(lo.x, -limit), ::std::max(lo.y, -limit)};
+      hi = {::std::min(hi.x,  limit), ::std::min(hi.y,  limit)};
+   }
+
+   if (lo.x >= hi.x or lo.y >= hi.y)
+      return false;
+
+   Real near = far;
+   for (int i = 0; i < 8; ++i)
+      near = ::std::min(near, (corner(casters, i) - mOrigin).Dot(mForward));
+   if (mPerspective)
+      near = ::std::max(near, far * 0.001_real);
+   if (near >= far)
+      return false;
+
+   mCenter = (lo + hi) / 2;
+   mScale = {2 / (hi.x - lo.x), 2 / (hi.y - lo.y)};
+   mDepth = {near, far};
+   return true;
+}
+
+/// Check if a box might cast a shadow inside the fitted region, i.e. if it   
+/// overlaps the region, and isn't entirely behind the receivers. Boxes that  
+/// are nearer to the light than the fitted depth range still reach it, and   
+/// the range has to be fitted again to include them                          
+///   @param box - the bounds of a potential caster                           
+///   @return true if the box might shadow a receiver                         
+bool ShadowFrustum::Reaches(const ASCIIBounds& box) const noexcept {
+   if (box.IsEmpty())
+      return false;
+
+   constexpr Real max = ::std::numeric_limits<Real>::max();
+   Vec2 lo {max, max};
+   Vec2 hi {-max, -max};
+   Real near = max;
+   bool behind = false;
+   for (int i = 0; i < 8; ++i) {
+      const Vec3 d = Vec3 {
+         i & 1 ? box.mMax.x : box.mMin.x,
+         i & 2 ? box.mMax.y : box.mMin.y,
+         i & 4 ? box.mMax.z : box.mMin.z
+      } - mOrigin;
+      const Real z = d.Dot(mForward);
+      Vec2 xy {d.Dot(mRight), d.Dot(mUp)};
+      near = ::std::min(near, z);
+
+      if (mPerspective) {
+         if (z <= 0) {
+            // Part of the box is behind the apex, so its projection    
+            // is unbounded - keep it, if the rest is in front          
+            behind = true;
+            continue;
+         }
+         xy /= z;
+      }
+
+      lo = {::std::min(lo.x, xy.x), ::std::min(lo.y, xy.y)};
+      hi = {::std::max(hi.x, xy.x), ::std::max(hi.y, xy.y)};
+   }
+
+   if (near >= mDepth.mMax)
+      return false;
+   if (behind)
+      return lo.x <= hi.x;
+
+   for (int axis = 0; axis < 2; ++axis) {
+      const Real half = 1 / mScale[axis];
+      if (hi[axis] < mCenter[axis] - half or lo[axis] > mCenter[axis] + half)
+         return false;
+   }
+   return true;
+}
+
+/// Check if a shadow projection covers everything another one does, so that  
+/// a shadowmap rendered with it can be reused                                
+///   @param other - the projection to check                                  
+///   @return true if other is inside this projection                         
+bool ShadowFrustum::Contains(const ShadowFrustum& other) const noexcept {
+   if (mPerspective != other.mPerspective
+   or mOrigin  != other.mOrigin
+   or mForward != other.mForward
+   or mRight   != other.mRight)
+      return false;
+
+   if (other.mDepth.mMin < mDepth.mMin or other.mDepth.mMax > mDepth.mMax)
+      return false;
+
+   for (int axis = 0; axis < 2; ++axis) {
+      const Real half = 1 / mScale[axis];
+      const Real otherHalf = 1 / other.mScale[axis];
+      if (other.mCenter[axis] - otherHalf < mCenter[axis] - half
+      or  other.mCenter[axis] + otherHalf > mCenter[axis] + half)
+         return false;
+   }
+   return true;
+}
+
+/// Grow the covered region and depth range, so that the projection keeps     
+/// containing the fitted one, while the content moves a bit                  
+///   @param fraction - how much to grow, relative to the size                
+///   @return the grown projection                                            
+auto ShadowFrustum::Grow(Real fraction) const noexcept -> ShadowFrustum {
+   ShadowFrustum result = *this;
+   result.mScale = {mScale.x / (1 + fraction), mScale.y / (1 + fraction)};
+
+   const Real margin = (mDepth.mMax - mDepth.mMin) * fraction / 2;
+   result.mDepth.mMax += margin;
+   result.mDepth.mMin = mPerspective
+      ? ::std::max(mDepth.mMin - margin, mDepth.mMin / 2)
+      : mDepth.mMin - margin;
+   return result;
+}
+
+/// Project a point onto the shadowmap                                        
+///   @param p - the point in world space                                     
+///   @return the map coordinates and depth, all in [0; 1] if the point is    
+///      inside the fitted region                                             
+auto ShadowFrustum::Project(const Vec3& p) const noexcept -> Vec3 {
+   const Vec3 d = p - mOrigin;
+   const Real z = d.Dot(mForward);
+   Vec2 xy {d.Dot(mRight), d.Dot(mUp)};
+   if (mPerspective)
+      xy /= ::std::max(z, ::std::numeric_limits<Real>::epsilon());
+
+   return {
+      ((xy.x - mCenter.x) * mScale.x + 1) / 2,
+      ((xy.y - mCenter.y) * mScale.y + 1) / 2,
+      (z - mDepth.mMin) / (mDepth.mMax - mDepth.mMin)
+   };
+}
+
+/// Check if a surface point is hidden from a light by a shadow caster        
+/// Points outside the fitted region are never shadowed                       
 ///   @param ps - the pipeline state                                          
-///   @param M - precomputed world matrix for light computation               
-///   @param triangle - three consecutive original vertices (object space)    
-///   @param clipped - a clipped triangle in NDC space                        
-template<bool LIT, bool DEPTH, bool SMOOTH, bool FOG, bool COLORIZE, bool SHADOWED>
-void ASCIIPipeline::RasterizeTriangle(
-   const PipelineState& ps, const Mat4& M,
-   const ASCIIGeometry::Vertex* triangle,
-   const Triangle4& clipped
-) const {
-   LANGULUS(PROFILE);
-   const Vec3 p0 = clipped[0].xyz();
-   const Vec3 p1 = clipped[1].xyz();
-   const Vec3 p2 = clipped[2].xyz();
-   const auto a = 0.5_real * (
-      -p1.y *   p2.x + 
-       p0.y * (-p1.x + p2.x) + 
-       p0.x * ( p1.y - p2.y) + 
+///   @param light - the light                                                
+///   @param p - the surface position in world space                          
+///   @return true if the light doesn't reach the point                       
+bool ASCIIPipeline::InShadow(const PipelineState& ps, const LightSubscriber& light, const Vec3& p) {
+   if (light.shadowmap < 0)
+      return false;
+
+   auto& shadow = *ps.mLayer->mShadowmaps[light.shadowmap];
+   auto& map = shadow.GetDepth();
+   const Vec3 q = shadow.mFrustum.Project(p);
+   const auto x = static_cast<int>(::std::floor(q.x * map.GetWidth()));
+   const auto y = static_cast<int>(::std::floor(q.y * map.GetHeight()));
+   if (x < 0 or y < 0 or x >= map.GetWidth() or y >= map.GetHeight())
+      return false;
+   return q.z - ShadowBias > map.Get(x, y);
+}
+
+/// Get the signed area of a triangle in NDC space                            
+///   @param p0, p1, p2 - the triangle vertices                               
+///   @return the area, whose sign depends on winding                         
+Real TriangleArea(const Vec3& p0, const Vec3& p1, const Vec3& p2) {
+   return 0.5_real * (
+      -p1.y *   p2.x +
+       p0.y * (-p1.x + p2.x) +
+       p0.x * ( p1.y - p2.y) +
        p1.x *   p2.y
    );
+}
 
-   // Cull based on winding if enabled                                  
+/// Check if a triangle is culled based on its winding, if culling enabled    
+///   @param area - the signed area of the triangle                           
+///   @return true if the triangle must not be drawn                          
+bool ASCIIPipeline::IsCulled(Real area) const noexcept {
    switch (mCull) {
-   case CullBack:  if (a  > 0) return; break;
-   case CullFront: if (a <= 0) return; break;
+   case CullBack:  return area  > 0;
+   case CullFront: return area <= 0;
    case NoCulling: break;
    }
+   return false;
+}
+
+/// Find all pixels covered by a triangle, and invoke a function with their   
+/// barycentric coordinates. Both the shading and the depth-only kernels scan 
+/// through here, so that they produce exactly the same depths                
+///   @param viewport - the part of the render buffer, that NDC space maps    
+///      to, in pixels. No pixel outside of it is ever scanned                
+///   @param p0, p1, p2 - the triangle vertices in NDC space                  
+///   @param a - the signed area of the triangle                              
+///   @param shade - invoked with the pixel and its barycentric coordinates   
+template<class F>
+void ASCIIPipeline::ScanTriangle(
+   const ASCIIRect& viewport,
+   const Vec3& p0, const Vec3& p1, const Vec3& p2,
+   Real a, F&& shade
+) const {
+   // Pixels are scanned relative to the viewport, and shaded in the    
+   // render buffer                                                     
+   const Scale2 resolution = viewport.GetScale();
+
+   // Triangles that are within a pixel or two on screen aren't worth   
+   // scanning - they are splatted onto the pixel nearest to their      
+   // center, with a single depth test and a single shade               
+   const auto px0 = (p0.x * resolution.x + resolution.x - 0.5_real) / 2;
+   const auto px1 = (p1.x * resolution.x + resolution.x - 0.5_real) / 2;
+   const auto px2 = (p2.x * resolution.x + resolution.x - 0.5_real) / 2;
+   const auto py0 = (resolution.y - 0.5_real - p0.y * resolution.y) / 2;
+   const auto py1 = (resolution.y - 0.5_real - p1.y * resolution.y) / 2;
+   const auto py2 = (resolution.y - 0.5_real - p2.y * resolution.y) / 2;
+   if (::std::max({px0, px1, px2}) - ::std::min({px0, px1, px2}) < MicroTriangleSize
+   and ::std::max({py0, py1, py2}) - ::std::min({py0, py1, py2}) < MicroTriangleSize) {
+      const auto x = static_cast<int>(::std::floor((px0 + px1 + px2) / 3 + 0.5_real));
+      const auto y = static_cast<int>(::std::floor((py0 + py1 + py2) / 3 + 0.5_real));
+      if (x >= 0 and y >= 0 and x < resolution.x and y < resolution.y)
+         shade(viewport.mX + x, viewport.mY + y, 1 / 3.0_real, 1 / 3.0_real, 1 / 3.0_real);
+      return;
+   }
 
-   // If reached, then triangle is visible                              
+   // If reached, then triangle is visible and big enough to be scanned 
    const auto term_a  = 1.0_real / (2.0_real * a);
    const auto term_s1 = p0.y * p2.x - p0.x * p2.y;
    const auto term_s2 = p2.y - p0.y;
@@ -211,65 +626,25 @@ void ASCIIPipeline::RasterizeTriangle(
    const auto term_t3_a = term_a * term_t3;
 
    // p0, p1, and p2 should be in NDC space                             
-   Vec2i minp = Math::Floor(Math::Min(p0.xy(), p1.xy(), p2.xy()) * ps.mResolution + 0.5);
-   minp.y -= ps.mResolution.y * 2;
-   minp = Math::Min(Math::Max(minp, -ps.mResolution), ps.mResolution);
-   minp = (minp + ps.mResolution) / 2;
+   Vec2i minp = Math::Floor(Math::Min(p0.xy(), p1.xy(), p2.xy()) * resolution + 0.5);
+   minp.y -= resolution.y * 2;
+   minp = Math::Min(Math::Max(minp, -resolution), resolution);
+   minp = (minp + resolution) / 2;
 
-   Vec2i maxp = Math::Ceil(Math::Max(p0.xy(), p1.xy(), p2.xy()) * ps.mResolution + 0.5);
-   maxp.y += ps.mResolution.y * 2;
-   maxp = Math::Min(Math::Max(maxp, -ps.mResolution), ps.mResolution);
-   maxp = (maxp + ps.mResolution) / 2;
-
-   // The normal                                                        
-   [[maybe_unused]] Vec3  n {0, 0, 1};
-   // The accumulated light colors                                      
-   [[maybe_unused]] RGBAf lit = 0;
-
-   if constexpr (LIT and not SMOOTH) {
-      // Get an average normal for the triangle for flat rendering      
-      n = Mat3(M) * (triangle[0].mNor + triangle[1].mNor + triangle[2].mNor);
-      n = n.Normalize();
-
-      // Just get the center of the triangle (in world space)           
-      auto p = M * (( triangle[0].mPos 
-                    + triangle[1].mPos
-                    + triangle[2].mPos ) / 3);
-
-      // Accumulate all lights                                          
-      for (auto& light : ps.mLights) {
-         // Determine light direction                                   
-         switch (light.type) {
-         case A::Light::Directional:
-         case A::Light::Spot:
-            // Direction is taken from the light instance               
-            lit += light.color * n.Dot(light.direction);
-            break;
-         case A::Light::Point:
-            // Direction is relative to light position                  
-            lit += light.color * n.Dot((light.position - p).Normalize());
-            break;
-         case A::Light::Domain:
-            TODO();
-         }
-      }
-
-      // And then clamp                                                 
-      if (lit.r > 1) lit.r = 1;
-      if (lit.g > 1) lit.g = 1;
-      if (lit.b > 1) lit.b = 1;
-      lit.a = 1;
-   }
+   Vec2i maxp = Math::Ceil(Math::Max(p0.xy(), p1.xy(), p2.xy()) * resolution + 0.5);
+   maxp.y += resolution.y * 2;
+   maxp = Math::Min(Math::Max(maxp, -resolution), resolution);
+   maxp = (maxp + resolution) / 2;
 
    // Iterate all pixels in the area of interest                        
    for (int y = minp.y; y < maxp.y; ++y) {
       bool row_started = false;
-      const auto screenv = -(y * 2 - ps.mResolution.y + 0.5_real) / ps.mResolution.y;
+      const auto screenv = -(y * 2 - resolution.y + 0.5_real) / resolution.y;
       const auto term_s3_v = term_s1_a + term_s3_a * screenv;
       const auto term_t3_v = term_t1_a + term_t3_a * screenv;
 
       for (int x = minp.x; x < maxp.x; ++x) {
-         const auto screenu = (x * 2 - ps.mResolution.x + 0.5_real) / ps.mResolution.x;
+         const auto screenu = (x * 2 - resolution.x + 0.5_real) / resolution.x;
          const auto s = term_s2_a * screenu + term_s3_v;
          const auto t = term_t2_a * screenu + term_t3_v;
          const auto d = 1 - s - t;
@@ -289,53 +664,287 @@ void ASCIIPipeline::RasterizeTriangle(
          // If reached, then pixel is inside triangle                   
          row_started = true;
 
-         // Interpolate depth at the current pixel                      
-         [[maybe_unused]] const Real z = p1.z * s + p2.z * t + p0.z * d;
-         if constexpr (DEPTH) {
-            auto& global_depth = ps.mLayer->mDepth.Get(x / mBufferScale.x, y / mBufferScale.y);
+         shade(viewport.mX + x, viewport.mY + y, s, t, d);
+      }
+   }
+}
 
-            // Do depth test                                            
-            if (z >= global_depth or z <= 0 or z >= 1)
-               continue;
+/// Rasterize only the depth of a single triangle into the layer's depth      
+/// buffer, without any attributes, and without touching any color buffers    
+///   @param layer - the layer that we're rendering to                        
+///   @param viewport - the part of the render buffer that is drawn to        
+///   @param clipped - a clipped triangle in NDC space                        
+void ASCIIPipeline::RasterizeDepth(
+   const ASCIILayer* layer, const ASCIIRect& viewport,
+   const Triangle4& clipped
+) const {
+   const Vec3 p0 = clipped[0].xyz();
+   const Vec3 p1 = clipped[1].xyz();
+   const Vec3 p2 = clipped[2].xyz();
+   const auto a = TriangleArea(p0, p1, p2);
+   if (IsCulled(a))
+      return;
 
-            //                                                          
-            // If reached, pixel depth is overwritten                   
-            global_depth = mDepth.Get(x, y) = z;
+   ScanTriangle(viewport, p0, p1, p2, a, [&](int x, int y, Real s, Real t, Real d) {
+      const Real z = p1.z * s + p2.z * t + p0.z * d;
+      auto& global_depth = layer->mDepth.Get(GetCellX(x), GetCellY(y));
+      if (z >= global_depth or z <= 0 or z >= 1)
+         return;
+      global_depth = z;
+   });
+}
+
+/// Accumulate the light a surface point receives from all lights             
+///   @tparam SHADOWED - skip lights, that are shadowed at the point          
+///   @param ps - the pipeline state                                          
+///   @param n - the surface normal in world space                            
+///   @param p - the surface position in world space                          
+///   @return the received light, clamped                                     
+template<bool SHADOWED>
+auto ASCIIPipeline::GatherLight(const PipelineState& ps, const Vec3& n, const Vec3& p) -> RGBAf {
+   RGBAf lit = 0;
+   for (auto& light : ps.mLights) {
+      if constexpr (SHADOWED) {
+         if (InShadow(ps, light, p))
+            continue;
+      }
+      lit += Illuminate(light, n, p);
+   }
+
+   if (lit.r > 1) lit.r = 1;
+   if (lit.g > 1) lit.g = 1;
+   if (lit.b > 1) lit.b = 1;
+   lit.a = 1;
+   return lit;
+}
+
+/// Hash a value's bytes                                                      
+///   @param value - the value to hash                                        
+///   @return the hash                                                        
+size_t HashBytes(const auto& value) {
+   return ::std::hash<::std::string_view> {}({
+      reinterpret_cast<const char*>(&value), sizeof(value)});
+}
+
+/// Get a version of the lights, which changes whenever the light they cast   
+/// might change, including their shadows                                     
+///   @tparam SHADOWED - whether shadows are applied - if not, shadowmaps     
+///      don't affect the version                                             
+///   @param ps - the pipeline state                                          
+///   @return the version, or zero if the lights change every frame, because  
+///      of dynamic shadow casters                                            
+template<bool SHADOWED>
+auto ASCIIPipeline::GetLightVersion(const PipelineState& ps) -> size_t {
+   size_t version = ps.mLights.GetCount() + 1;
+   auto mix = [&version](size_t value) {
+      version ^= value + 0x9e3779b9 + (version << 6) + (version >> 2);
+   };
+
+   for (const auto& light : ps.mLights) {
+      mix(HashBytes(light.color));
+      mix(HashBytes(light.position));
+      mix(HashBytes(light.direction));
+      mix(HashBytes(light.type));
+      mix(HashBytes(light.range));
+      mix(HashBytes(light.spread));
+
+      if constexpr (SHADOWED) {
+         if (light.shadowmap >= 0) {
+            const auto& shadow = *ps.mLayer->mShadowmaps[light.shadowmap];
+            if (shadow.mDynamic)
+               return 0;
+            mix(shadow.mVersion);
          }
+      }
+   }
+   return version ? version : 1;
+}
 
-         if constexpr (FOG or COLORIZE or (LIT and SMOOTH)) {
-            //                                                          
-            // If reached, pixel color is overwritten                   
-            auto& pixel = mBuffer.Get(x, y);
-
-            /*const auto fog = Clamp(
-               (fogRange.GetMax() - z) / fogRange.Length(),
-               0_real, 1_real
-            );*/ //TODO clamp not working in this context, check TODO.md
-            [[maybe_unused]] RGBAf fogColor = mFogColor;
-            [[maybe_unused]] Real  fog = 0;
-            if constexpr (FOG) {
-               fog = (mFogRange.GetMax() - (1 - z) * 1000) / mFogRange.Length();
-               if (fog >= 1) {
-                  // Fog can optimize-out far pixels                    
-                  pixel = fogColor;
-                  continue;
-               }
-               else if (fog < 0)
-                  fog = 0;
+/// Get the light received by a vertex buffer, calculating it only if the     
+/// lights or the transformation changed since the last time it was drawn     
+///   @tparam SHADING - either flat or Gouraud shading                        
+///   @tparam SHADOWED - apply shadowmaps                                     
+///   @param ps - the pipeline state                                          
+///   @param M - the instance transformation                                  
+///   @param vertices - the vertex buffer                                     
+///   @return the light for each vertex, or for each triangle when flat, or   
+///      nullptr if the lights can't be cached                                
+template<ASCIIPipeline::Shading SHADING, bool SHADOWED>
+auto ASCIIPipeline::Bake(
+   const PipelineState& ps, const Mat4& M,
+   const TMany<ASCIIGeometry::Vertex>& vertices
+) const -> const RGBAf* {
+   const auto lights = GetLightVersion<SHADOWED>(ps);
+   if (not lights)
+      return nullptr;
+
+   auto& baked = mBaked[{
+      ps.mSubscriber.mesh->GetVersion(), vertices.GetRaw(), HashBytes(M),
+      SHADING, SHADOWED
+   }];
+   baked.mLastUsed = ps.mFrame;
+   if (baked.mLights == lights)
+      return baked.mColors.data();
+
+   // Relight                                                           
+   baked.mLights = lights;
+   const Mat3 N = Mat3(M);
+   if constexpr (SHADING == Gouraud) {
+      baked.mColors.resize(vertices.GetCount());
+      for (Offset i = 0; i < vertices.GetCount(); ++i) {
+         const Vec3 n = (N * vertices[i].mNor).Normalize();
+         const Vec4 p = M * vertices[i].mPos;
+         baked.mColors[i] = GatherLight<SHADOWED>(ps, n, p.xyz());
+      }
+   }
+   else {
+      baked.mColors.resize(vertices.GetCount() / 3);
+      for (Offset i = 0; i + 2 < vertices.GetCount(); i += 3) {
+         const auto triangle = vertices.GetRaw() + i;
+         const Vec3 n = (N * (triangle[0].mNor + triangle[1].mNor + triangle[2].mNor)).Normalize();
+         const Vec4 p = M * ((triangle[0].mPos + triangle[1].mPos + triangle[2].mPos) / 3);
+         baked.mColors[i / 3] = GatherLight<SHADOWED>(ps, n, p.xyz());
+      }
+   }
+   return baked.mColors.data();
+}
 
-               fogColor *= fog;
-            }
+/// Rasterize a single triangle                                               
+///   @tparam LIT - whether or not to calculate lights and speculars          
+///   @tparam DEPTH - whether or not to perform depth test and write depth    
+///   @tparam SHADING - calculate lights per triangle, vertex, or pixel       
+///   @tparam FOG - apply fog                                                 
+///   @tparam COLORIZE - apply vertex colors                                  
+///   @tparam SHADOWED - apply shadowmaps                                     
+///   @param ps - the pipeline state                                          
+///   @param M - precomputed world matrix for light computation               
+///   @param triangle - three consecutive original vertices (object space)    
+///   @param vertexLight - light received by the three vertices when using    
+///      Gouraud shading, or by the whole triangle when flat shading with     
+///      baked lights, nullptr otherwise                                      
+///   @param clipped - a clipped triangle in NDC space                        
+template<bool LIT, bool DEPTH, ASCIIPipeline::Shading SHADING, bool FOG, bool COLORIZE, bool SHADOWED>
+void ASCIIPipeline::RasterizeTriangle(
+   const PipelineState& ps, const Mat4& M,
+   const ASCIIGeometry::Vertex* triangle,
+   [[maybe_unused]] const RGBAf* vertexLight,
+   const Triangle4& clipped
+) const {
+   LANGULUS(PROFILE);
+   const Vec3 p0 = clipped[0].xyz();
+   const Vec3 p1 = clipped[1].xyz();
+   const Vec3 p2 = clipped[2].xyz();
+   const auto a = TriangleArea(p0, p1, p2);
+   if (IsCulled(a)) {
+      ++mStats.mTrianglesCulled;
+      return;
+   }
+   ++mStats.mTrianglesRasterized;
+
+   // Barycentrics change linearly across the screen, and so do texture 
+   // coordinates, so a single mip is picked for the whole triangle     
+   const ASCIITexture* texture = ps.mSubscriber.texture;
+   int mip = 0;
+   if (texture and texture->GetMipCount()) {
+      const Scale2 resolution = ps.mViewport.GetScale();
+      const Real dsdx =  (p2.y - p0.y) / (a * resolution.x);
+      const Real dtdx =  (p0.y - p1.y) / (a * resolution.x);
+      const Real dsdy = -(p0.x - p2.x) / (a * resolution.y);
+      const Real dtdy = -(p1.x - p0.x) / (a * resolution.y);
+      const Vec2 du = triangle[1].mTex - triangle[0].mTex;
+      const Vec2 dv = triangle[2].mTex - triangle[0].mTex;
+      mip = texture->SelectMip(du * dsdx + dv * dtdx, du * dsdy + dv * dtdy);
+   }
+   else texture = nullptr;
+
+   // The normal                                                        
+   [[maybe_unused]] Vec3  n {0, 0, 1};
+   // The accumulated light colors                                      
+   [[maybe_unused]] RGBAf lit = 0;
 
-            if constexpr (COLORIZE) {
-               // Interpolate the color                                 
-               //TODO fix color multiplication with normalization, see todo.md
-               pixel = triangle[1].mCol * s
-                     + triangle[2].mCol * t
-                     + triangle[0].mCol * d;
+   if constexpr (LIT and SHADING == Flat) {
+      if (vertexLight) {
+         // Lights were baked                                           
+         lit = *vertexLight;
+      }
+      else {
+         // Get an average normal for the triangle for flat rendering   
+         n = Mat3(M) * (triangle[0].mNor + triangle[1].mNor + triangle[2].mNor);
+         n = n.Normalize();
+
+         // Just get the center of the triangle (in world space)        
+         auto p = M * (( triangle[0].mPos
+                       + triangle[1].mPos
+                       + triangle[2].mPos ) / 3);
+
+         // Accumulate all lights, that aren't shadowed at the center   
+         lit = GatherLight<SHADOWED>(ps, n, p.xyz());
+      }
+   }
+
+   // Depth test and shade a single pixel, with the given barycentric   
+   // coordinates. Fragments are counted locally, and added to the      
+   // statistics once per triangle                                      
+   size_t tested = 0, passed = 0, shaded = 0;
+   auto shade = [&](int x, int y, Real s, Real t, Real d) {
+      ++tested;
+
+      // Interpolate depth at the current pixel                         
+      [[maybe_unused]] const Real z = p1.z * s + p2.z * t + p0.z * d;
+      if constexpr (DEPTH) {
+         auto& global_depth = ps.mLayer->mDepth.Get(GetCellX(x), GetCellY(y));
+
+         // Do depth test. After a depth prepass, the nearest surface   
+         // is already in the depth buffer, and only it passes          
+         if (z <= 0 or z >= 1)
+            return;
+         if (ps.mPrepassed ? z > global_depth + PrepassTolerance : z >= global_depth)
+            return;
+
+         //                                                             
+         // If reached, pixel depth is overwritten                      
+         global_depth = mDepth.Get(x, y) = z;
+      }
+
+      // Mark the cell for Assemble                                     
+      mCoverage.Mark(x, y);
+      ++passed;
+
+      if constexpr (FOG or COLORIZE or (LIT and SHADING != Flat)) {
+         //                                                             
+         // If reached, pixel color is overwritten                      
+         auto& pixel = mBuffer.Get(x, y);
+         ++shaded;
+
+         /*const auto fog = Clamp(
+            (fogRange.GetMax() - z) / fogRange.Length(),
+            0_real, 1_real
+         );*/ //TODO clamp not working in this context, check TODO.md
+         [[maybe_unused]] RGBAf fogColor = mFogColor;
+         [[maybe_unused]] Real  fog = 0;
+         if constexpr (FOG) {
+            fog = (mFogRange.GetMax() - (1 - z) * 1000) / mFogRange.Length();
+            if (fog >= 1) {
+               // Fog can optimize-out far pixels                       
+               pixel = fogColor;
+               return;
             }
+            else if (fog < 0)
+               fog = 0;
+
+            fogColor *= fog;
+         }
+
+         if constexpr (COLORIZE) {
+            // Interpolate the color                                    
+            //TODO fix color multiplication with normalization, see todo.md
+            pixel = triangle[1].mCol * s
+                  + triangle[2].mCol * t
+                  + triangle[0].mCol * d;
+         }
 
-            if constexpr (LIT and SMOOTH) {
+         if constexpr (LIT and SHADING != Flat) {
+            if constexpr (SHADING == Smooth) {
                // Interpolate and transform the normal per-pixel        
                n = Mat3(M) * Vec3( triangle[0].mNor * d
                                  + triangle[1].mNor * s
@@ -348,57 +957,55 @@ void ASCIIPipeline::RasterizeTriangle(
                              + triangle[1].mPos * s
                              + triangle[2].mPos * t );
 
-               // Accumulate all lights                                 
-               for (auto& light : ps.mLights) {
-                  // Determine light direction                          
-                  switch (light.type) {
-                  case A::Light::Directional:
-                  case A::Light::Spot:
-                     // Direction is taken from the light instance      
-                     lit += light.color * n.Dot(light.direction);
-                     break;
-                  case A::Light::Point:
-                     // Direction is relative to light position         
-                     lit += light.color * n.Dot((light.position - p).Normalize());
-                     break;
-                  case A::Light::Domain:
-                     TODO();
-                  }
-               }
-
-               // And then clamp                                        
-               if (lit.r > 1) lit.r = 1;
-               if (lit.g > 1) lit.g = 1;
-               if (lit.b > 1) lit.b = 1;
-               lit.a = 1;
-
-               if constexpr (COLORIZE)
-                  // Blend with vertex colors                           
-                  pixel *= ps.mSubscriber.color * lit;
-               else
-                  // Just assign the instance color * light color       
-                  pixel  = ps.mSubscriber.color * lit;
-            }
-            else if constexpr (COLORIZE) {
-               // Blend with vertex colors                              
-               if constexpr (LIT)
-                  pixel *= ps.mSubscriber.color * lit;
-               else
-                  pixel *= ps.mSubscriber.color;
+               // Accumulate all lights, that aren't shadowed           
+               lit = GatherLight<SHADOWED>(ps, n, p.xyz());
             }
             else {
-               // Just assign the instance color                        
-               if constexpr (LIT)
-                  pixel = ps.mSubscriber.color * lit;
-               else
-                  pixel = ps.mSubscriber.color;
+               // Interpolate the light received by the vertices        
+               lit = vertexLight[0] * d
+                   + vertexLight[1] * s
+                   + vertexLight[2] * t;
             }
 
-            if constexpr (FOG)
-               pixel = fogColor + pixel * (1 - fog);
+            if constexpr (COLORIZE)
+               // Blend with vertex colors                              
+               pixel *= ps.mSubscriber.color * lit;
+            else
+               // Just assign the instance color * light color          
+               pixel  = ps.mSubscriber.color * lit;
+         }
+         else if constexpr (COLORIZE) {
+            // Blend with vertex colors                                 
+            if constexpr (LIT)
+               pixel *= ps.mSubscriber.color * lit;
+            else
+               pixel *= ps.mSubscriber.color;
+         }
+         else {
+            // Just assign the instance color                           
+            if constexpr (LIT)
+               pixel = ps.mSubscriber.color * lit;
+            else
+               pixel = ps.mSubscriber.color;
+         }
+
+         if (texture) {
+            // Modulate with the texture                                
+            pixel *= texture->Sample(
+               triangle[1].mTex * s
+             + triangle[2].mTex * t
+             + triangle[0].mTex * d, mip);
          }
+
+         if constexpr (FOG)
+            pixel = fogColor + pixel * (1 - fog);
       }
-   }
+   };
+
+   ScanTriangle(ps.mViewport, p0, p1, p2, a, shade);
+   mStats.mFragmentsTested += tested;
+   mStats.mFragmentsPassed += passed;
+   mStats.mFragmentsShaded += shaded;
 }
 
 #define MAP_ARGUMENT_TO_TEMPLATE(Arg, tArgId, Nest) \
@@ -411,7 +1018,178 @@ void ASCIIPipeline::RasterizeTriangle(
       Nest \
    }
 
+#define MAP_SHADING_TO_TEMPLATE(Arg, tArgId, Nest) \
+   switch (Arg) { \
+   case Flat: { \
+      constexpr Shading tArg##tArgId = Flat; \
+      Nest \
+   } break; \
+   case Gouraud: { \
+      constexpr Shading tArg##tArgId = Gouraud; \
+      Nest \
+   } break; \
+   case Smooth: { \
+      constexpr Shading tArg##tArgId = Smooth; \
+      Nest \
+   } break; \
+   }
+
+/// Estimate how many pixels a model space unit covers on the screen, by      
+/// projecting the bounds of a mesh                                           
+///   @param MVP - model*view*projection matrix                               
+///   @param bounds - the model space bounds                                  
+///   @param resolution - the resolution of the viewport, in pixels           
+///   @return the number of pixels per unit, or the largest possible number   
+///      if any part of the bounds is behind the camera                       
+Real PixelsPerUnit(const Mat4& MVP, const ASCIIBounds& bounds, const Scale2& resolution) {
+   Vec2 lo, hi;
+   for (int i = 0; i < 8; ++i) {
+      const Vec4 p = MVP * Vec4 {
+         i & 1 ? bounds.mMax.x : bounds.mMin.x,
+         i & 2 ? bounds.mMax.y : bounds.mMin.y,
+         i & 4 ? bounds.mMax.z : bounds.mMin.z,
+         1
+      };
+
+      if (p.w <= 0)
+         return ::std::numeric_limits<Real>::max();
+
+      const Vec2 ndc {p.x / p.w, p.y / p.w};
+      if (i == 0)
+         lo = hi = ndc;
+      else {
+         lo = {::std::min(lo.x, ndc.x), ::std::min(lo.y, ndc.y)};
+         hi = {::std::max(hi.x, ndc.x), ::std::max(hi.y, ndc.y)};
+      }
+   }
+
+   const Vec3 extent = bounds.mMax - bounds.mMin;
+   const Real largest = ::std::max({extent.x, extent.y, extent.z});
+   if (largest <= 0)
+      return 0;
+
+   const Real pixels = ::std::max(
+      (hi.x - lo.x) * resolution.x / 2,
+      (hi.y - lo.y) * resolution.y / 2
+   );
+   return pixels / largest;
+}
+
+/// Estimate how many shadowmap texels a model space unit covers, by          
+/// projecting the bounds of a mesh onto the map                              
+///   @param shadow - the light's shadow projection                           
+///   @param M - the model transformation                                     
+///   @param bounds - the model space bounds                                  
+///   @param size - the size of the shadowmap, in texels                      
+///   @return the number of texels per unit, or the largest possible number   
+///      if any part of the bounds is behind the light                        
+Real TexelsPerUnit(const ShadowFrustum& shadow, const Mat4& M, const ASCIIBounds& bounds, const Scale2& size) {
+   const auto world = bounds.Transform(M);
+   Vec2 lo, hi;
+   for (int i = 0; i < 8; ++i) {
+      const Vec3 q = shadow.Project(Vec3 {
+         i & 1 ? world.mMax.x : world.mMin.x,
+         i & 2 ? world.mMax.y : world.mMin.y,
+         i & 4 ? world.mMax.z : world.mMin.z
+      });
+
+      if (q.z < 0)
+         return ::std::numeric_limits<Real>::max();
+
+      if (i == 0)
+         lo = hi = q.xy();
+      else {
+         lo = {::std::min(lo.x, q.x), ::std::min(lo.y, q.y)};
+         hi = {::std::max(hi.x, q.x), ::std::max(hi.y, q.y)};
+      }
+   }
+
+   const Vec3 extent = bounds.mMax - bounds.mMin;
+   const Real largest = ::std::max({extent.x, extent.y, extent.z});
+   if (largest <= 0)
+      return 0;
+
+   const Real texels = ::std::max(
+      (hi.x - lo.x) * size.x,
+      (hi.y - lo.y) * size.y
+   );
+   return texels / largest;
+}
+
+/// Rasterize the depth of a triangle into a shadowmap, keeping the nearest   
+/// Triangles aren't culled, so that both sides of a surface cast shadows     
+///   @param map - the shadowmap                                              
+///   @param triangle - the projected triangle, as returned by Project        
+void RasterizeShadow(ASCIIBuffer<float>& map, const Vec3* triangle) {
+   const Vec2 size {
+      static_cast<Real>(map.GetWidth()),
+      static_cast<Real>(map.GetHeight())
+   };
+   const Vec2 p0 {triangle[0].x * size.x, triangle[0].y * size.y};
+   const Vec2 p1 {triangle[1].x * size.x, triangle[1].y * size.y};
+   const Vec2 p2 {triangle[2].x * size.x, triangle[2].y * size.y};
+
+   const Real area = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+   if (area == 0)
+      return;
+
+   const auto minx = ::std::max(0, static_cast<int>(::std::floor(::std::min({p0.x, p1.x, p2.x}))));
+   const auto miny = ::std::max(0, static_cast<int>(::std::floor(::std::min({p0.y, p1.y, p2.y}))));
+   const auto maxx = ::std::min(map.GetWidth(),  static_cast<int>(::std::ceil(::std::max({p0.x, p1.x, p2.x}))));
+   const auto maxy = ::std::min(map.GetHeight(), static_cast<int>(::std::ceil(::std::max({p0.y, p1.y, p2.y}))));
+
+   for (int y = miny; y < maxy; ++y) {
+      const Real py = y + 0.5_real;
+      for (int x = minx; x < maxx; ++x) {
+         const Real px = x + 0.5_real;
+         const Real s = ((p2.x - p1.x) * (py - p1.y) - (p2.y - p1.y) * (px - p1.x)) / area;
+         const Real t = ((p0.x - p2.x) * (py - p2.y) - (p0.y - p2.y) * (px - p2.x)) / area;
+         const Real d = 1 - s - t;
+         if (s < 0 or t < 0 or d < 0)
+            continue;
+
+         const auto z = static_cast<float>(
+            triangle[0].z * s + triangle[1].z * t + triangle[2].z * d);
+         auto& texel = map.Get(x, y);
+         if (z < texel)
+            texel = z;
+      }
+   }
+}
+
+/// Draw the depth of a mesh instance into a light's shadowmap                
+/// The mesh is simplified as much as the shadowmap resolution allows         
+///   @param shadow - the shadow projection of the light                      
+///   @param map - the shadowmap to draw into                                 
+///   @param M - the instance transformation                                  
+///   @param mesh - the mesh to draw                                          
+void ASCIIPipeline::RenderShadow(
+   const ShadowFrustum& shadow, ASCIIBuffer<float>& map,
+   const Mat4& M, const ASCIIGeometry& mesh
+) {
+   LANGULUS(PROFILE);
+   if (not mesh.MadeOfTriangles())
+      return;
+
+   const Scale2 size = map.GetView().GetScale();
+   const auto lod = mesh.SelectLOD(TexelsPerUnit(shadow, M, mesh.GetBounds(), size));
+   const auto& vertices = mesh.GetVertices(lod);
+   for (Offset i = 0; i + 2 < vertices.GetCount(); i += 3) {
+      // Triangles passing behind a spot light are skipped              
+      Vec3 triangle[3];
+      bool behind = false;
+      for (int k = 0; k < 3; ++k) {
+         triangle[k] = shadow.Project((M * vertices[i + k].mPos).xyz());
+         behind |= triangle[k].z < 0;
+      }
+
+      if (not behind)
+         RasterizeShadow(map, triangle);
+   }
+}
+
 /// Rasterize all primitives inside a mesh                                    
+/// The mesh is simplified as much as possible, without losing a pixel        
 ///   @param ps - pipeline state                                              
 void ASCIIPipeline::RasterizeMesh(const PipelineState& ps) const {
    const auto M   = ps.mSubscriber.transform;
@@ -419,44 +1197,210 @@ void ASCIIPipeline::RasterizeMesh(const PipelineState& ps) const {
    auto& mesh     = ps.mSubscriber.mesh;
 
    if (mesh->MadeOfTriangles()) {
-      // Rasterize triangles...                                         
-      auto vertices = mesh->GetVertices().GetRaw();
-      bool firstVertex = true;
-      Range4 dataRangeBeforeW;
-      Range4 dataRangeAfterW;
-      for (Offset i = 0; i < mesh->GetVertices().GetCount(); ++i) {
-         auto p = MVP * vertices[i].mPos;
-         if (firstVertex)
-            dataRangeBeforeW.mMin = dataRangeBeforeW.mMax = p;
-         else
-            dataRangeBeforeW.Embrace(p);
-
-         p /= p.w;
-
-         if (firstVertex)
-            dataRangeAfterW.mMin = dataRangeAfterW.mMax = p;
-         else
-            dataRangeAfterW.Embrace(p);
-
-         firstVertex = false;
-      }
+      // Transform all vertices to clip space first                     
+      const auto lod = mesh->SelectLOD(PixelsPerUnit(MVP, mesh->GetBounds(), ps.mViewport.GetScale()));
+      const auto& vertices = mesh->GetVertices(lod);
+      mClipSpace.resize(vertices.GetCount());
+      for (Offset i = 0; i < vertices.GetCount(); ++i)
+         mClipSpace[i] = MVP * vertices[i].mPos;
 
+      // Rasterize triangles...                                         
       MAP_ARGUMENT_TO_TEMPLATE(mLit,      0,
       MAP_ARGUMENT_TO_TEMPLATE(mDepthTest,1,
-      MAP_ARGUMENT_TO_TEMPLATE(mSmooth,   2,
+      MAP_SHADING_TO_TEMPLATE( mShading,  2,
       MAP_ARGUMENT_TO_TEMPLATE(mFog,      3,
       MAP_ARGUMENT_TO_TEMPLATE(mColorize, 4,
       MAP_ARGUMENT_TO_TEMPLATE(mShadows,  5,
-         for (Offset i = 0; i < mesh->GetVertices().GetCount(); i += 3) {
-            ClipTriangle(MVP, vertices + i, [&](const Triangle4& t) {
-               RasterizeTriangle<tArg0, tArg1, tArg2, tArg3, tArg4, tArg5>(ps, M, vertices + i, t);
-            });
-         }
+         (RasterizeTriangles<tArg0, tArg1, tArg2, tArg3, tArg4, tArg5>)(
+            ps, M, vertices, mClipSpace.data());
       ))))));
    }
    else TODO();
 }
 
+/// Draw only the depth of all instances of a batch into the layer's depth    
+/// buffer. Used as a prepass, after which RenderInstanced shades only the    
+/// nearest surfaces, instead of shading everything that is later overdrawn.  
+/// Instances pick the same simplification as they do in RenderInstanced, so  
+/// that both passes produce the same depths                                  
+///   @param layer - the layer that we're rendering to                        
+///   @param pv - the projection-view matrix                                  
+///   @param batch - instances to draw                                        
+void ASCIIPipeline::RenderDepth(
+   const ASCIILayer* layer,
+   const Mat4& pv,
+   const PipeBatch& batch
+) const {
+   LANGULUS(PROFILE);
+   const RenderTimer timer {mStats.mRenderTime};
+   if (not mDepthTest or not batch.mesh or not batch.transforms)
+      return;
+
+   if (not batch.mesh->MadeOfTriangles())
+      TODO();
+
+   const auto viewport = GetViewport(layer);
+   const Scale2 resolution = viewport.GetScale();
+   const auto& bounds = batch.mesh->GetBounds();
+   for (const auto& transform : batch.transforms) {
+      const Mat4 MVP = pv * transform;
+      const auto lod = batch.mesh->SelectLOD(PixelsPerUnit(MVP, bounds, resolution));
+      const auto& vertices = batch.mesh->GetVertices(lod);
+      mClipSpace.resize(vertices.GetCount());
+      for (Offset i = 0; i < vertices.GetCount(); ++i)
+         mClipSpace[i] = MVP * vertices[i].mPos;
+
+      for (Offset i = 0; i + 2 < vertices.GetCount(); i += 3) {
+         ClipTriangle(mClipSpace.data() + i, [&](const Triangle4& t) {
+            RasterizeDepth(layer, viewport, t);
+         });
+      }
+   }
+}
+
+/// Draw all instances of a batch, choosing the rasterizer only once          
+///   @param layer - the layer that we're rendering to                        
+///   @param pv - the projection-view matrix                                  
+///   @param batch - instances to draw                                        
+///   @param lights - list of lights to apply                                 
+///   @param prepassed - whether the depth of the batch is already in the     
+///      layer's depth buffer, see RenderDepth                                
+void ASCIIPipeline::RenderInstanced(
+   const ASCIILayer* layer,
+   const Mat4& pv,
+   const PipeBatch& batch,
+   const TMany<LightSubscriber>& lights,
+   bool prepassed
+) const {
+   LANGULUS(PROFILE);
+   const RenderTimer timer {mStats.mRenderTime};
+   if (not batch.mesh or not batch.transforms)
+      return;
+
+   LANGULUS_ASSUME(DevAssumes,
+      batch.transforms.GetCount() == batch.colors.GetCount(),
+      "Instance arrays mismatch");
+
+   if (not batch.mesh->MadeOfTriangles())
+      TODO();
+
+   MAP_ARGUMENT_TO_TEMPLATE(mLit,      0,
+   MAP_ARGUMENT_TO_TEMPLATE(mDepthTest,1,
+   MAP_SHADING_TO_TEMPLATE( mShading,  2,
+   MAP_ARGUMENT_TO_TEMPLATE(mFog,      3,
+   MAP_ARGUMENT_TO_TEMPLATE(mColorize, 4,
+   MAP_ARGUMENT_TO_TEMPLATE(mShadows,  5,
+      (RasterizeInstances<tArg0, tArg1, tArg2, tArg3, tArg4, tArg5>)(
+         layer, pv, batch, lights, prepassed);
+   ))))));
+}
+
+/// Rasterize all instances of a batch                                        
+/// Each instance picks its own level of simplification. Instances are then   
+/// transformed to clip space in passes, each pass handling as many instances 
+/// as there's room for in the clip space buffer                              
+///   @param layer - the layer that we're rendering to                        
+///   @param pv - the projection-view matrix                                  
+///   @param batch - instances to draw                                        
+///   @param lights - list of lights to apply                                 
+///   @param prepassed - whether the depth of the batch was already drawn     
+template<bool LIT, bool DEPTH, ASCIIPipeline::Shading SHADING, bool FOG, bool COLORIZE, bool SHADOWED>
+void ASCIIPipeline::RasterizeInstances(
+   const ASCIILayer* layer,
+   const Mat4& pv,
+   const PipeBatch& batch,
+   const TMany<LightSubscriber>& lights,
+   bool prepassed
+) const {
+   const auto viewport = GetViewport(layer);
+   const Scale2 resolution = viewport.GetScale();
+   const size_t instanceCount = batch.transforms.GetCount();
+   const auto& bounds = batch.mesh->GetBounds();
+
+   size_t first = 0;
+   while (first < instanceCount) {
+      // Pick the instances of the pass and their simplification, and   
+      // transform all of their vertices                                
+      mClipSpace.clear();
+      mPassInstances.clear();
+
+      auto last = first;
+      for (; last < instanceCount; ++last) {
+         const Mat4 MVP = pv * batch.transforms[last];
+         const auto lod = batch.mesh->SelectLOD(PixelsPerUnit(MVP, bounds, resolution));
+         const auto& vertices = batch.mesh->GetVertices(lod);
+         if (mClipSpace.size() and mClipSpace.size() + vertices.GetCount() > MaxClipSpaceVertices)
+            break;
+
+         mPassInstances.push_back({&vertices, mClipSpace.size()});
+         for (Offset i = 0; i < vertices.GetCount(); ++i)
+            mClipSpace.push_back(MVP * vertices[i].mPos);
+      }
+
+      // Rasterize them                                                 
+      for (auto k = first; k < last; ++k) {
+         const auto& pass = mPassInstances[k - first];
+         const PipeSubscriber sub {
+            batch.colors[k], batch.transforms[k], batch.mesh, batch.texture
+         };
+         const PipelineState ps {layer, viewport, pv, sub, lights, mFrame, prepassed};
+         RasterizeTriangles<LIT, DEPTH, SHADING, FOG, COLORIZE, SHADOWED>(
+            ps, sub.transform, *pass.mVertices, mClipSpace.data() + pass.mOffset);
+      }
+
+      first = last;
+   }
+}
+
+/// Rasterize all triangles of a vertex buffer                                
+///   @param ps - pipeline state                                              
+///   @param M - precomputed world matrix for light computation               
+///   @param vertices - the triangle list to rasterize                        
+///   @param clipSpace - the same vertices, already in clip space             
+template<bool LIT, bool DEPTH, ASCIIPipeline::Shading SHADING, bool FOG, bool COLORIZE, bool SHADOWED>
+void ASCIIPipeline::RasterizeTriangles(
+   const PipelineState& ps, const Mat4& M,
+   const TMany<ASCIIGeometry::Vertex>& vertices, const Vec4* clipSpace
+) const {
+   // Reuse lights baked in previous frames, if enabled                 
+   const RGBAf* vertexLight = nullptr;
+   if constexpr (LIT and SHADING != Smooth) {
+      if (mBake)
+         vertexLight = Bake<SHADING, SHADOWED>(ps, M, vertices);
+   }
+
+   // When shading per-vertex, light all vertices before rasterizing    
+   // Vertices aren't indexed, so shared ones are lit for each triangle 
+   if constexpr (LIT and SHADING == Gouraud) {
+      if (not vertexLight) {
+         mVertexLight.resize(vertices.GetCount());
+         const Mat3 N = Mat3(M);
+         for (Offset i = 0; i < vertices.GetCount(); ++i) {
+            const Vec3 n = (N * vertices[i].mNor).Normalize();
+            const Vec4 p = M * vertices[i].mPos;
+            mVertexLight[i] = GatherLight<SHADOWED>(ps, n, p.xyz());
+         }
+         vertexLight = mVertexLight.data();
+      }
+   }
+
+   // Vertex lights are per vertex, baked flat lights are per triangle  
+   constexpr Offset stride = SHADING == Gouraud ? 1 : 3;
+   mStats.mTriangles += vertices.GetCount() / 3;
+   for (Offset i = 0; i + 2 < vertices.GetCount(); i += 3) {
+      bool visible = false;
+      ClipTriangle(clipSpace + i, [&](const Triangle4& t) {
+         visible = true;
+         RasterizeTriangle<LIT, DEPTH, SHADING, FOG, COLORIZE, SHADOWED>(
+            ps, M, vertices.GetRaw() + i,
+            vertexLight ? vertexLight + i / stride : nullptr, t);
+      });
+
+      if (not visible)
+         ++mStats.mTrianglesClipped;
+   }
+}
+
 namespace
 {
    template<int FIRST, int SECOND, int...TAIL>
@@ -480,6 +1424,7 @@ namespace
 ///   @param layer - the layer that we're rendering to                        
 void ASCIIPipeline::Assemble(const ASCIILayer* layer) const {
    LANGULUS(PROFILE);
+   const RenderTimer timer {mStats.mAssembleTime};
 
    auto gradient3x3 = [&](
       ::std::array<RGBAf, 9>&& colors,
@@ -687,17 +1632,30 @@ void ASCIIPipeline::Assemble(const ASCIILayer* layer) const {
    // pipeline might have some odd ways of deciding color and symbols,  
    // so assemble those here, and write to layer                        
    // mBufferXScale x mBufferYScale pixels -> 1 layer pixel             
-   if (mBufferScale == 1) {
+   // Only cells covered since the last Assemble are written, and they  
+   // are marked in the layer's coverage for compositing. Nothing is    
+   // drawn outside of the viewport, so only its rows are visited, and  
+   // its edges are treated as image edges when detecting symbols       
+   const auto rect = layer->mScissor.Clip(layer->mImage.GetWidth(), layer->mImage.GetHeight());
+   const int x0 = rect.mX, x1 = rect.mX + rect.mWidth;
+   const int y0 = rect.mY, y1 = rect.mY + rect.mHeight;
+   if (mBuffer.GetWidth() == mCells.x and mBuffer.GetHeight() == mCells.y) {
       // Pixels map 1:1                                                 
-      for (uint32_t y = 0; y < layer->mImage.GetView().mHeight; ++y) {
-         for (uint32_t x = 0; x < layer->mImage.GetView().mWidth; ++x) {
-            auto to = layer->mImage.GetPixel(x, y);
-            auto& from = mBuffer.Get(x, y);
-            ::std::string_view c = " ";
+      for (int y = y0; y < y1; ++y) {
+         const auto& span = mCoverage.GetSpan(y);
+         if (span.IsEmpty())
+            continue;
+
+         const auto to = layer->mImage.GetRow(y);
+         const auto from = mBuffer.GetRow(y);
+         const auto mask = mCoverage.GetMask().GetRow(y);
+         const int end = ::std::min(span.mEnd, x1);
+         for (int x = ::std::max(span.mBegin, x0); x < end; ++x) {
+            if (not mask[x])
+               continue;
 
-            if (x and y and y < layer->mImage.GetView().mHeight-1
-                        and x < layer->mImage.GetView().mWidth-1
-            ) {
+            ::std::string_view c = " ";
+            if (x > x0 and y > y0 and y < y1 - 1 and x < x1 - 1) {
                c = gradient3x3({
                   mBuffer.Get(x-1, y-1), mBuffer.Get(x, y-1), mBuffer.Get(x+1, y-1),
                   mBuffer.Get(x-1, y  ), mBuffer.Get(x, y  ), mBuffer.Get(x+1, y  ),
@@ -709,14 +1667,78 @@ void ASCIIPipeline::Assemble(const ASCIILayer* layer) const {
                });
             }
 
-            //if (d > 0.0f and d < 1000.0f) {
-               // Write pixel only if in valid depth range              
-               to.mSymbol = c;
-               to.mFgColor = from;
-               to.mBgColor = from;
-            //}
+            to.mSymbols[x] = c;
+            to.mFgColors[x] = from[x];
+            to.mBgColors[x] = from[x];
+            layer->mCoverage.Mark(x, y);
          }
       }
    }
-   else TODO();
+   else {
+      // Pixels don't map 1:1, either because of the style, or because  
+      // of the resolution scale. Each cell gets the average of the     
+      // covered pixels in its footprint, or the pixel it is in, if     
+      // pixels are bigger than cells                                   
+      const int w = mBuffer.GetWidth();
+      const int h = mBuffer.GetHeight();
+      for (int y = y0; y < y1; ++y) {
+         const int py0 = y * h / mCells.y;
+         const int py1 = ::std::max(py0 + 1, (y + 1) * h / mCells.y);
+
+         // Find the covered cells of the row, from the pixel spans     
+         int begin = w, end = 0;
+         for (int py = py0; py < py1; ++py) {
+            const auto& span = mCoverage.GetSpan(py);
+            if (span.IsEmpty())
+               continue;
+            begin = ::std::min(begin, span.mBegin);
+            end = ::std::max(end, span.mEnd);
+         }
+         if (begin >= end)
+            continue;
+
+         const auto to = layer->mImage.GetRow(y);
+         const int cx0 = ::std::max(x0, begin * mCells.x / w);
+         const int cx1 = ::std::min(x1, (end * mCells.x + w - 1) / w);
+         for (int x = cx0; x < cx1; ++x) {
+            const int px0 = x * w / mCells.x;
+            const int px1 = ::std::max(px0 + 1, (x + 1) * w / mCells.x);
+
+            RGBAf color = 0;
+            float depth = 1;
+            int count = 0;
+            for (int py = py0; py < py1; ++py) {
+               const auto mask = mCoverage.GetMask().GetRow(py);
+               const auto from = mBuffer.GetRow(py);
+               for (int px = px0; px < px1; ++px) {
+                  if (not mask[px])
+                     continue;
+                  color += from[px];
+                  depth = ::std::min(depth, mDepth.Get(px, py));
+                  ++count;
+               }
+            }
+            if (not count)
+               continue;
+
+            // Stretched pixels write their depth only to a single cell 
+            // when rasterized, so it's spread over the rest here       
+            if (mDepthTest) {
+               auto& d = layer->mDepth.Get(x, y);
+               d = ::std::min(d, depth);
+            }
+
+            color *= 1 / static_cast<Real>(count);
+            to.mSymbols[x] = " ";
+            to.mFgColors[x] = color;
+            to.mBgColors[x] = color;
+            layer->mCoverage.Mark(x, y);
+         }
+      }
+   }
+
+   // Count covered pixels of the render buffer, and not cells, as      
+   // pixels might be averaged into a cell, or stretched over several   
+   mStats.mPixelsAssembled += mCoverage.GetCount();
+   mCoverage.Clear();
 }
@@ -12,6 +12,7 @@
 #include <Langulus/Math/Normal.hpp>
 #include <Langulus/Mesh.hpp>
 #include <Langulus/IO.hpp>
+#include <unordered_map>
 
 
 /// Compiled renderable                                                       
@@ -26,18 +27,111 @@ struct PipeSubscriber {
    const ASCIITexture*  texture;
 };
 
+/// Compiled instances of renderables, that share geometry and texture        
+/// Per-instance data is kept in separate arrays, so that all instances can   
+/// be drawn with a single setup                                              
+struct PipeBatch {
+   // Mesh                                                              
+   const ASCIIGeometry* mesh;
+   // Texture                                                           
+   const ASCIITexture*  texture;
+   // Instance transformations                                          
+   TMany<Mat4> transforms;
+   // Overall color for each instance                                   
+   TMany<RGBAf> colors;
+};
+
+/// Work done by a pipeline since its last Clear(), i.e. in a single frame    
+/// Only shading passes are counted, not the depth prepass                    
+struct ASCIIPipelineStats {
+   // Triangles submitted for drawing                                   
+   size_t mTriangles = 0;
+   // Triangles discarded, because they were outside of the viewport    
+   size_t mTrianglesClipped = 0;
+   // Clipped triangles discarded because of their winding, and ones    
+   // that were scanned. Clipping might split a triangle in several     
+   size_t mTrianglesCulled = 0;
+   size_t mTrianglesRasterized = 0;
+   // Pixels that were depth tested, that passed, and that got a color  
+   size_t mFragmentsTested = 0;
+   size_t mFragmentsPassed = 0;
+   size_t mFragmentsShaded = 0;
+   // Pixels of the render buffer that Assemble wrote into layers. The  
+   // unit is render buffer pixels, same as for fragments, whatever the 
+   // style or resolution scale - so fragments passed per assembled     
+   // pixel is the overdraw                                             
+   size_t mPixelsAssembled = 0;
+   // Seconds spent drawing, and assembling                             
+   Real mRenderTime = 0;
+   Real mAssembleTime = 0;
+
+   /// Accumulate the work of another pipeline                                
+   void Add(const ASCIIPipelineStats& other) noexcept {
+      mTriangles           += other.mTriangles;
+      mTrianglesClipped    += other.mTrianglesClipped;
+      mTrianglesCulled     += other.mTrianglesCulled;
+      mTrianglesRasterized += other.mTrianglesRasterized;
+      mFragmentsTested     += other.mFragmentsTested;
+      mFragmentsPassed     += other.mFragmentsPassed;
+      mFragmentsShaded     += other.mFragmentsShaded;
+      mPixelsAssembled     += other.mPixelsAssembled;
+      mRenderTime          += other.mRenderTime;
+      mAssembleTime        += other.mAssembleTime;
+   }
+};
+
+/// A light's shadow projection, fitted around the content it has to shadow   
+/// It is kept as a basis instead of a matrix, so that fitting it is just a   
+/// matter of projecting box corners onto its axes                            
+struct ShadowFrustum {
+   // Apex of spot lights, any point along directional lights           
+   Vec3 mOrigin;
+   // Axes of the shadowmap, mForward points away from the light        
+   Vec3 mRight;
+   Vec3 mUp;
+   Vec3 mForward;
+   // Center and inverse half-size of the fitted region on the map      
+   Vec2 mCenter;
+   Vec2 mScale;
+   // Depth range along mForward, mapped to [0; 1]                      
+   Range1 mDepth;
+   // Spot lights project perspectively, directional lights don't       
+   bool mPerspective = false;
+
+   bool Fit(const Vec3&, const Vec3&, Real, const ASCIIBounds&, const ASCIIBounds&) noexcept;
+   bool Reaches(const ASCIIBounds&) const noexcept;
+   bool Contains(const ShadowFrustum&) const noexcept;
+   auto Grow(Real) const noexcept -> ShadowFrustum;
+   auto Project(const Vec3&) const noexcept -> Vec3;
+};
+
 /// A compiled light                                                          
 struct LightSubscriber {
    // Light color premultiplied by intensity                            
    RGBAf color;
-   // Light MVP, used as a camera transformation for drawing shadowmaps 
-   Mat4 transform;
    // Light position in world space, used for calculating point lights  
    Vec3 position;
    // Light direction in world space, for directional/spot lights       
    Vec3 direction;
    // Type of the light                                                 
    A::Light::Type type;
+   // Radius of influence for point and spot lights, zero if unbounded  
+   Real range;
+   // Cosine of half the spot light cone angle                          
+   Real spread;
+   // Size of the light's shadowmap, in texels                          
+   Scale2 shadowmapSize;
+   // The light and instance this was compiled from, identifying the    
+   // light's shadow between frames                                     
+   const ASCIILight* light;
+   const A::Instance* instance;
+   // Shadow projection, fitted by ASCIILayer::CompileShadows           
+   ShadowFrustum shadow {};
+   // Index of the shadowmap in the layer's pool, -1 if not shadowed    
+   int shadowmap = -1;
+   // The light's shadow casters, as a range of the level's casters     
+   size_t firstCaster = 0;
+   size_t casterCount = 0;
 };
 
 
@@ -82,8 +176,15 @@ private:
    bool mDepthTest = true;
    // Toggle light calculation                                          
    bool mLit = true;
-   // Toggle smooth shading                                             
-   bool mSmooth = false;
+   // Shading mode                                                      
+   enum Shading {
+      // Lights are calculated once per triangle                        
+      Flat,
+      // Lights are calculated once per vertex, and interpolated        
+      Gouraud,
+      // Normals are interpolated, and lights are calculated per pixel  
+      Smooth
+   } mShading = Flat;
    // Toggle fog calculation                                            
    bool mFog = true;
    RGBAf mFogColor = {0.30f, 0, 0, 1.0f};
@@ -92,6 +193,10 @@ private:
    bool mColorize = false;
    // Toggle shadows                                                    
    bool mShadows = true;
+   // Toggle caching of lighting between frames, for instances whose    
+   // transformation and lights don't change. Used only with flat and   
+   // Gouraud shading, because smooth shading lights every pixel        
+   bool mBake = false;
 
    // Toggle culling                                                    
    enum Cull {
@@ -101,9 +206,30 @@ private:
    // Rendering style                                                   
    ASCIIStyle mStyle = ASCIIStyle::Fullblocks;
 
+   // Triangles smaller than this many pixels in both directions are    
+   // splatted, instead of scanned                                      
+   static constexpr Real MicroTriangleSize = 2;
+
+   // Offset applied to the depth of shadow receivers, so that surfaces 
+   // don't shadow themselves                                           
+   static constexpr Real ShadowBias = 0.01;
+
+   // How much farther than the prepassed depth a pixel can be, and     
+   // still pass the depth test                                         
+   static constexpr Real PrepassTolerance = 0.000001;
+
    // Some styles involve more pixels per character                     
    // Halfblocks are 2x2 pixels per symbol, while Braille is 2x4        
    Scale2i mBufferScale;
+   // Fraction of mBufferScale that is actually rendered, controlled by 
+   // the renderer to fit in its frame budget                           
+   Real mResolutionScale = 1;
+   // The resolution scale never goes below this many pixels per cell   
+   static constexpr Real MinPixelsPerCell = 0.25;
+   // Size of the layer, in cells, as of the last Resize()              
+   Scale2i mCells;
+   // Work done since the last Clear()                                  
+   mutable ASCIIPipelineStats mStats;
 
    // An intermediate render buffer, used only by the pipeline          
    // This buffer is then compiled into an image inside ASCIILayer      
@@ -112,36 +238,154 @@ private:
    // Intermediate (may be sub-pixel) depth buffer, that also acts as   
    // a stencil buffer (pixel is valid if depth is not at max)          
    mutable ASCIIBuffer<float> mDepth;
-   
-   // Shadowmaps generated by lights                                    
-   mutable TMany<ASCIIBuffer<float>> mShadowmaps;
+
+   // Which layer cells were drawn since the last Assemble, so that only
+   // those are written to the layer's image                            
+   mutable ASCIICoverage mCoverage;
+
+   // Clip space vertices of the instances being drawn, reused between  
+   // draws, and limited in size by splitting large batches             
+   mutable ::std::vector<Vec4> mClipSpace;
+   // Light received by each vertex, when shading per-vertex            
+   mutable ::std::vector<RGBAf> mVertexLight;
+   static constexpr size_t MaxClipSpaceVertices = 1 << 16;
+
+   // The vertex buffer and clip space offset of each instance in the   
+   // current pass, as instances may use different simplifications      
+   struct PassInstance {
+      const TMany<ASCIIGeometry::Vertex>* mVertices;
+      size_t mOffset;
+   };
+   mutable ::std::vector<PassInstance> mPassInstances;
+
+   // Identifies a level of detail of a geometry, drawn with a specific 
+   // transformation. The geometry is identified by its version, which  
+   // changes when it's evicted and converted again, so that a vertex   
+   // buffer reusing the memory of an evicted one is never mistaken for 
+   // it. Shading and shadowing are part of the key, because they change
+   // what, and how many colors are baked                               
+   struct BakeKey {
+      uint64_t mGeometry;
+      const ASCIIGeometry::Vertex* mVertices;
+      size_t mTransform;
+      Shading mShading;
+      bool mShadowed;
+
+      bool operator == (const BakeKey&) const noexcept = default;
+
+      struct Hash {
+         size_t operator() (const BakeKey& key) const noexcept {
+            auto a = static_cast<size_t>(key.mGeometry);
+            a ^= reinterpret_cast<size_t>(key.mVertices) + 0x9e3779b9 + (a << 6) + (a >> 2);
+            a ^= key.mTransform + 0x9e3779b9 + (a << 6) + (a >> 2);
+            const auto mode = static_cast<size_t>(key.mShading) * 2 + key.mShadowed;
+            return a ^ (mode + 0x9e3779b9 + (a << 6) + (a >> 2));
+         }
+      };
+   };
+
+   // Light received by a vertex buffer - once per vertex for Gouraud   
+   // shading, once per triangle for flat shading                       
+   struct Baked {
+      // Version of the lights the colors were calculated with          
+      size_t mLights = 0;
+      // Last renderer frame the colors were used in                    
+      uint64_t mLastUsed = 0;
+      ::std::vector<RGBAf> mColors;
+   };
+   mutable ::std::unordered_map<BakeKey, Baked, BakeKey::Hash> mBaked;
+   // The renderer frame being rendered, as of the last Clear()         
+   uint64_t mFrame = 0;
 
 public:
    ASCIIPipeline(ASCIIRenderer*, const Many&);
 
-   void Clear(const RGBAf&, float);
+   void Clear(const RGBAf&, float, uint64_t frame);
+   void ForgetBaked(const ::std::vector<uint64_t>& geometries);
    void Resize(int x, int y);
    void Render(const ASCIILayer*, const Mat4&, const PipeSubscriber&, const TMany<LightSubscriber>&) const;
+   void RenderInstanced(const ASCIILayer*, const Mat4&, const PipeBatch&, const TMany<LightSubscriber>&, bool prepassed = false) const;
+   void RenderDepth(const ASCIILayer*, const Mat4&, const PipeBatch&) const;
    void Assemble(const ASCIILayer*) const;
 
+   void SetResolutionScale(Real) noexcept;
+   auto GetResolutionScale() const noexcept -> Real;
+   auto GetRenderTime() const noexcept -> Real;
+   auto GetStatistics() const noexcept -> const ASCIIPipelineStats&;
+   auto GetBufferBytes() const noexcept -> size_t;
+
+   auto GetFogDepth() const noexcept -> Real;
+   bool IsFogged(const ASCIIBounds&, const Mat4&) const noexcept;
+
+   static void RenderShadow(const ShadowFrustum&, ASCIIBuffer<float>&, const Mat4&, const ASCIIGeometry&);
+
 private:
    struct PipelineState {
       const ASCIILayer* mLayer;
-      const Scale2 mResolution;
+      // The part of the render buffer that is drawn to, in pixels      
+      const ASCIIRect mViewport;
       const Mat4& mProjectedView;
       const PipeSubscriber& mSubscriber;
       const TMany<LightSubscriber>& mLights;
+      // The renderer frame being rendered                              
+      const uint64_t mFrame;
+      // Depth was already drawn by RenderDepth                         
+      const bool mPrepassed = false;
    };
 
+   auto GetViewport(const ASCIILayer*) const noexcept -> ASCIIRect;
+
+   /// Get the column of the cell, that a pixel of the render buffer is in    
+   int GetCellX(int x) const noexcept {
+      return x * mCells.x / mBuffer.GetWidth();
+   }
+
+   /// Get the row of the cell, that a pixel of the render buffer is in       
+   int GetCellY(int y) const noexcept {
+      return y * mCells.y / mBuffer.GetHeight();
+   }
+
    void RasterizeMesh(const PipelineState&) const;
+   bool IsCulled(Real) const noexcept;
+   static bool InShadow(const PipelineState&, const LightSubscriber&, const Vec3&);
+   template<bool SHADOWED>
+   static auto GatherLight(const PipelineState&, const Vec3&, const Vec3&) -> RGBAf;
+   template<bool SHADOWED>
+   static auto GetLightVersion(const PipelineState&) -> size_t;
 
-   template<bool LIT, bool DEPTH, bool SMOOTH, bool FOG, bool COLORIZE, bool SHADOWED>
+   template<Shading SHADING, bool SHADOWED>
+   auto Bake(const PipelineState&, const Mat4&, const TMany<ASCIIGeometry::Vertex>&) const -> const RGBAf*;
+
+   template<bool LIT, bool DEPTH, Shading SHADING, bool FOG, bool COLORIZE, bool SHADOWED>
+   void RasterizeInstances(
+      const ASCIILayer*,
+      const Mat4&,
+      const PipeBatch&,
+      const TMany<LightSubscriber>&,
+      bool
+   ) const;
+
+   template<bool LIT, bool DEPTH, Shading SHADING, bool FOG, bool COLORIZE, bool SHADOWED>
+   void RasterizeTriangles(
+      const PipelineState&,
+      const Mat4&,
+      const TMany<ASCIIGeometry::Vertex>&,
+      const Vec4*
+   ) const;
+
+   template<bool LIT, bool DEPTH, Shading SHADING, bool FOG, bool COLORIZE, bool SHADOWED>
    void RasterizeTriangle(
       const PipelineState&,
       const Mat4&,
       const ASCIIGeometry::Vertex*,
+      const RGBAf*,
       const Triangle4&
    ) const;
 
-   void ClipTriangle(const Mat4&, const ASCIIGeometry::Vertex*, auto&&) const;
+   template<class F>
+   void ScanTriangle(const ASCIIRect&, const Vec3&, const Vec3&, const Vec3&, Real, F&&) const;
+
+   void RasterizeDepth(const ASCIILayer*, const ASCIIRect&, const Triangle4&) const;
+
+   void ClipTriangle(const Vec4*, auto&&) const;
 };
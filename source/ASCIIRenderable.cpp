@@ -41,11 +41,13 @@ auto ASCIIRenderable::GetRenderer() const noexcept -> ASCIIRenderer* {
 }
 
 /// Get VRAM geometry corresponding to an octave of this renderable           
-/// This is the point where content might be generated upon request           
+/// This is the point where content might be generated upon request. The      
+/// conversion happens in the background, and until it's done, the closest    
+/// octave that is already converted is used instead                          
 ///   @param lod - information used to extract the best LOD                   
-///   @return the VRAM geometry or nullptr if content is not available        
+///   @return the VRAM geometry or nullptr if content is not available yet    
 auto ASCIIRenderable::GetGeometry(const LOD& lod) const -> const ASCIIGeometry* {
-   const auto i = lod.GetAbsoluteIndex();
+   const Offset i = lod.GetAbsoluteIndex();
    if (not mLOD[i].mGeometry and mGeometryContent) {
       // Cache geometry to a more cache-friendly format                 
       Verbs::Create creator {
@@ -55,7 +57,39 @@ auto ASCIIRenderable::GetGeometry(const LOD& lod) const -> const ASCIIGeometry*
       mLOD[i].mGeometry = creator->template As<ASCIIGeometry*>();
    }
 
-   return mLOD[i].mGeometry;
+   // Converted content might have been evicted, so request it again    
+   const auto frame = GetRenderer()->GetFrame();
+   if (mLOD[i].mGeometry) {
+      mLOD[i].mGeometry->Request();
+      if (mLOD[i].mGeometry->Poll()) {
+         mLOD[i].mGeometry->Touch(frame);
+         return mLOD[i].mGeometry;
+      }
+   }
+
+   // Fall back to the closest octave, that is ready                    
+   auto ready = [&](Offset j) -> const ASCIIGeometry* {
+      auto& geometry = mLOD[j].mGeometry;
+      if (not geometry or not geometry->Poll())
+         return nullptr;
+
+      geometry->Touch(frame);
+      return geometry;
+   };
+
+   for (Offset d = 1; d < LOD::IndexCount; ++d) {
+      if (i >= d) {
+         if (auto geometry = ready(i - d))
+            return geometry;
+      }
+
+      if (i + d < LOD::IndexCount) {
+         if (auto geometry = ready(i + d))
+            return geometry;
+      }
+   }
+
+   return nullptr;
 }
 
 /// Get VRAM texture corresponding to an octave of this renderable            
@@ -73,9 +107,29 @@ auto ASCIIRenderable::GetTexture(const LOD& lod) const -> const ASCIITexture* {
       mLOD[i].mTexture = creator->template As<ASCIITexture*>();
    }
 
+   // Uploaded content might have been evicted, so request it again     
+   // Textures that are still converting have no mips, and aren't       
+   // sampled until they're ready                                       
+   if (mLOD[i].mTexture) {
+      mLOD[i].mTexture->Request();
+      mLOD[i].mTexture->Poll();
+      mLOD[i].mTexture->Touch(GetRenderer()->GetFrame());
+   }
+
    return mLOD[i].mTexture;
 }
 
+/// Get the model space bounds of any geometry, that is already cached        
+/// Doesn't generate any content, so it's safe to use while culling           
+///   @return the bounds, or nullptr if no geometry has been cached yet       
+auto ASCIIRenderable::GetBounds() const noexcept -> const ASCIIBounds* {
+   for (const auto& lod : mLOD) {
+      if (lod.mGeometry and lod.mGeometry->IsReady())
+         return &lod.mGeometry->GetBounds();
+   }
+   return nullptr;
+}
+
 /// Get uniform color                                                         
 ///   @return the color                                                       
 auto ASCIIRenderable::GetColor() const -> RGBA {
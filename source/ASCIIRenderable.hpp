@@ -45,6 +45,7 @@ public:
    auto GetRenderer() const noexcept -> ASCIIRenderer*;
    auto GetGeometry(const LOD&) const -> const ASCIIGeometry*;
    auto GetTexture(const LOD&) const -> const ASCIITexture*;
+   auto GetBounds() const noexcept -> const ASCIIBounds*;
    auto GetColor() const -> RGBA;
    auto GetOrCreatePipeline(const LOD&, const ASCIILayer*) const -> ASCIIPipeline*;
 
@@ -7,6 +7,7 @@
 ///                                                                           
 #include "ASCII.hpp"
 #include <Langulus/Platform.hpp>
+#include <algorithm>
 #include <set>
 
 
@@ -16,7 +17,7 @@
 ASCIIRenderer::ASCIIRenderer(ASCII* producer, const Many& descriptor)
    : Resolvable   {this}
    , ProducedFrom {producer, descriptor}
-   , mBackbuffer  {this} {
+   , mSwapchain   {this, this, this} {
    VERBOSE_ASCII("Initializing...");
 
    // Retrieve relevant traits from the environment                     
@@ -29,13 +30,24 @@ ASCIIRenderer::ASCIIRenderer(ASCII* producer, const Many& descriptor)
    SeekValueAux<Traits::MousePosition>(descriptor, mMousePosition);
    SeekValueAux<Traits::MouseScroll  >(descriptor, mMouseScroll);
 
+   descriptor.ForEach([this](ASCIIRenderMode mode) {
+      mRenderMode = mode;
+   });
+
    Couple(descriptor);
    VERBOSE_ASCII("Initialized");
+
+   // Started last, so that nothing can throw while the thread is       
+   // joinable, and terminate the process on unwinding                  
+   if (mRenderMode == ASCIIRenderMode::Threaded)
+      mRenderThread = ::std::thread {&ASCIIRenderer::RenderThread, this};
 }
 
 /// First stage destruction                                                   
 void ASCIIRenderer::Teardown()  {
-   mBackbuffer.Reset();
+   StopRenderThread();
+   for (auto& image : mSwapchain)
+      image.Reset();
 
    mTextures.Teardown();
    mGeometries.Teardown();
@@ -60,6 +72,7 @@ void ASCIIRenderer::Refresh() {
 /// Also initialized the renderer if a window is provided                     
 ///   @param verb - creation verb                                             
 void ASCIIRenderer::Create(Verb& verb) {
+   const ::std::scoped_lock lock {mResourceMutex};
    mLayers.Create(this, verb);
    mPipelines.Create(this, verb);
    mGeometries.Create(this, verb);
@@ -71,48 +84,436 @@ void ASCIIRenderer::Create(Verb& verb) {
 void ASCIIRenderer::Interpret(Verb& verb) {
    verb.ForEach([&](DMeta meta) {
       if (meta->template CastsTo<A::Image>())
-         verb << &mBackbuffer;
+         verb << &mSwapchain[mPresented];
    });
 }
 
 /// Render an object, along with all of its children                          
 /// Rendering pipeline depends on each entity's components                    
 void ASCIIRenderer::Draw() {
+   Prepare();
+   Render();
+   Present();
+}
+
+/// First stage of drawing a frame, done on the caller's thread               
+/// Compiles the frame and sizes all buffers for it, so that rendering never  
+/// has to touch anything but the renderer's own buffers. In threaded mode,   
+/// also presents the latest rendered frame, and hands the next one to the    
+/// render thread                                                             
+void ASCIIRenderer::Prepare() {
    LANGULUS(PROFILE);
+   mFramePending = false;
    if (mWindow->IsMinimized())
       return;
 
-   RenderConfig config {Colors::Red, 1_real};
+   if (mRenderMode == ASCIIRenderMode::Immediate) {
+      mFrameConfig = Generate();
+      {
+         const ::std::scoped_lock lock {mResourceMutex};
+         for (auto& layer : mLayers)
+            layer.Publish();
+
+         ControlResolution();
+         PrepareBuffers(mFrameConfig, mSwapchain[mPresented]);
+      }
+      mFramePending = true;
+      return;
+   }
+
+   // Present the latest frame that the render thread has finished, if  
+   // any - this frees a backbuffer for it to continue                  
+   {
+      ::std::unique_lock lock {mFrameMutex};
+      if (mReadyImage >= 0) {
+         mPresented = mReadyImage;
+         mReadyImage = -1;
+         lock.unlock();
+         mFrameSignal.notify_all();
+         DrawWindow();
+      }
+   }
+
+   // Compile the next snapshot. The render thread reads only the       
+   // published scenes, so this overlaps with it rendering the last one 
+   const auto config = Generate();
+
+   // Wait for the render thread to finish the previous snapshot. This  
+   // is the back-pressure point - if presentation falls behind, the    
+   // render thread stalls on a full swap chain, and in turn stalls us  
+   ::std::unique_lock lock {mFrameMutex};
+   mFrameSignal.wait(lock, [this] {
+      return mRenderingImage < 0 or mQuit;
+   });
+   if (mQuit)
+      return;
+
+   // Pick a backbuffer that is neither presented, nor waiting          
+   for (int i = 0; i < SwapchainSize; ++i) {
+      if (i != mPresented and i != mReadyImage) {
+         mRenderingImage = i;
+         break;
+      }
+   }
+
+   // Publish the snapshot, and size all buffers for it, while the      
+   // render thread is idle                                             
+   {
+      const ::std::scoped_lock resources {mResourceMutex};
+      for (auto& layer : mLayers)
+         layer.Publish();
+
+      ControlResolution();
+      PrepareBuffers(config, mSwapchain[mRenderingImage]);
+   }
+
+   mSnapshotConfig = config;
+   mSnapshotPending = true;
+   lock.unlock();
+   mFrameSignal.notify_all();
+}
+
+/// Second stage of drawing a frame - renders the frame compiled by Prepare() 
+/// in immediate mode. Renderers don't share any mutable state, so different  
+/// renderers can do this in parallel. Does nothing in threaded mode, where   
+/// the render thread does it                                                 
+void ASCIIRenderer::Render() {
+   if (not mFramePending)
+      return;
+
+   Render(mFrameConfig, mSwapchain[mPresented]);
+}
+
+/// Last stage of drawing a frame - presents the frame rendered by Render()   
+/// in immediate mode. Must be called on the same thread as Prepare(). Does   
+/// nothing in threaded mode, where frames are presented by Prepare()         
+void ASCIIRenderer::Present() {
+   if (not mFramePending)
+      return;
+
+   DrawWindow();
+   mFramePending = false;
+}
+
+/// Draw the presented backbuffer in the window, and time it                  
+void ASCIIRenderer::DrawWindow() {
+   Real time = 0;
+   {
+      const RenderTimer timer {time};
+      (void) mWindow->Draw(&mSwapchain[mPresented]);
+   }
+
+   const ::std::scoped_lock lock {mStatsMutex};
+   mPresentTime = time;
+}
+
+/// Compile the draw lists for all layers, on the caller's thread             
+///   @return the configuration to render the compiled scene with             
+auto ASCIIRenderer::Generate() -> RenderConfig {
+   LANGULUS(PROFILE);
+   RenderConfig config {Colors::Red, 1_real, {
+      static_cast<int>(mWindow->GetSize().x),
+      static_cast<int>(mWindow->GetSize().y)
+   }};
+
+   config.mFrame = ++mFrame;
+   {
+      const RenderTimer timer {config.mGenerateTime};
+      for (auto& layer : mLayers)
+         layer.Generate();
+
+      EvictContent();
+   }
+   return config;
+}
+
+/// Evict the least recently used geometry and textures, until the converted  
+/// content fits in the memory budget. Content used by the frame that was     
+/// just compiled, or by the one that might still be rendering in threaded    
+/// mode, is never evicted                                                    
+void ASCIIRenderer::EvictContent() {
+   LANGULUS(PROFILE);
+   struct Candidate {
+      uint64_t mLastUsed;
+      size_t mBytes;
+      ASCIIGeometry* mGeometry;
+      ASCIITexture* mTexture;
+   };
+
+   // Only this thread writes the statistics, so they are read without  
+   // locking, and published under mStatsMutex when done                
+   auto stats = mMemoryStats;
+   stats.mBudget = mMemoryBudget;
+   stats.mGeometryBytes = stats.mTextureBytes = 0;
+   stats.mResident = stats.mEntries = 0;
+
+   ::std::vector<Candidate> candidates;
+   auto gather = [&](auto& content, size_t& bytes, Candidate candidate) {
+      ++stats.mEntries;
+      candidate.mBytes = content.GetBytes();
+      if (not candidate.mBytes)
+         return;
+
+      ++stats.mResident;
+      bytes += candidate.mBytes;
+      candidate.mLastUsed = content.GetLastUsed();
+      if (candidate.mLastUsed + 1 < mFrame)
+         candidates.push_back(candidate);
+   };
+
+   for (auto& geometry : mGeometries)
+      gather(geometry, stats.mGeometryBytes, {0, 0, &geometry, nullptr});
+   for (auto& texture : mTextures)
+      gather(texture, stats.mTextureBytes, {0, 0, nullptr, &texture});
+
+   auto total = stats.mGeometryBytes + stats.mTextureBytes;
+   if (total > mMemoryBudget) {
+      // Evict the oldest first                                         
+      ::std::sort(candidates.begin(), candidates.end(),
+         [](const Candidate& a, const Candidate& b) {
+            return a.mLastUsed < b.mLastUsed;
+         });
+
+      for (auto& candidate : candidates) {
+         if (total <= mMemoryBudget)
+            break;
+
+         if (candidate.mGeometry) {
+            mEvictedGeometry.push_back(candidate.mGeometry->GetVersion());
+            candidate.mGeometry->Evict();
+            stats.mGeometryBytes -= candidate.mBytes;
+         }
+         else {
+            candidate.mTexture->Evict();
+            stats.mTextureBytes -= candidate.mBytes;
+         }
+
+         total -= candidate.mBytes;
+         --stats.mResident;
+         ++stats.mEvictions;
+      }
+
+      VERBOSE_ASCII("Memory after eviction: ", total, " of ", mMemoryBudget, " bytes");
+   }
+
+   const ::std::scoped_lock lock {mStatsMutex};
+   mMemoryStats = stats;
+}
+
+/// Size the backbuffer, and all pipeline and layer buffers, for rendering    
+/// the published scenes. Buffers keep their size between frames, so this     
+/// rarely allocates anything                                                 
+///   @attention called on the caller's thread, while holding mResourceMutex, 
+///      and while the render thread is idle                                  
+///   @param config - the configuration of the published scenes               
+///   @param backbuffer - the image to render into                            
+void ASCIIRenderer::PrepareBuffers(const RenderConfig& config, ASCIIImage& backbuffer) {
+   const int sizex = config.mResolution.x;
+   const int sizey = config.mResolution.y;
+   backbuffer.Resize(sizex, sizey);
+
+   // Lighting baked for evicted geometry will never be used again      
+   for (auto& pipe : mPipelines) {
+      pipe.Resize(sizex, sizey);
+      pipe.ForgetBaked(mEvictedGeometry);
+   }
+   mEvictedGeometry.clear();
 
-   // Generate the draw lists for all layers                            
    for (auto& layer : mLayers)
-      layer.Generate();
+      layer.PrepareBuffers(config);
+}
+
+/// Render all published layer scenes into a backbuffer                       
+///   @attention all buffers must be prepared with PrepareBuffers()           
+///   @param config - the configuration of the published scenes               
+///   @param backbuffer - the image to render into                            
+void ASCIIRenderer::Render(const RenderConfig& config, ASCIIImage& backbuffer) {
+   LANGULUS(PROFILE);
+
+   // Collect layers and pipelines, so that the factories are locked    
+   // only while iterating them, and not for the whole frame            
+   Layers layers;
+   Pipelines pipes;
+   {
+      const ::std::scoped_lock lock {mResourceMutex};
+      for (auto& layer : mLayers)
+         layers.push_back(&layer);
+      for (auto& pipe : mPipelines)
+         pipes.push_back(&pipe);
+   }
+
+   ASCIIFrameStats stats;
+   stats.mFrame = config.mFrame;
+   stats.mGenerateTime = config.mGenerateTime;
+
+   // Time the whole frame, for the resolution controller               
+   {
+      const RenderTimer frameTimer {stats.mRenderTime};
+      if (not layers.empty()) {
+         // Clear all pipelines                                         
+         for (auto pipe : pipes)
+            pipe->Clear(config.mClearColor, config.mClearDepth, config.mFrame);
+
+         // Render all layers, and composite only the cells they covered
+         // The first layer clears the uncovered cells in the same pass,
+         // so the backbuffer is touched in full only once              
+         bool first = true;
+         for (const auto layer : layers) {
+            layer->Render(config);
+
+            const RenderTimer timer {stats.mCompositeTime};
+            if (layer->GetStyle() & ASCIILayer::Blended) {
+               if (first)
+                  backbuffer.Fill(" ", Colors::White, config.mClearColor);
+               backbuffer.Blend(layer->mImage, layer->mCoverage);
+            }
+            else if (first) {
+               backbuffer.CopyMaskedOrFill(layer->mImage, layer->mCoverage,
+                  " ", Colors::White, config.mClearColor);
+            }
+            else backbuffer.CopyMasked(layer->mImage, layer->mCoverage);
+
+            first = false;
+         }
+      }
+      else backbuffer.Fill(" ", Colors::White, config.mClearColor);
+   }
+
+   GatherStatistics(stats, layers, pipes);
+}
+
+/// Collect the statistics of the frame that was just rendered, and make      
+/// them available to GetStatistics()                                         
+///   @param stats - [in/out] the statistics, with the timings that were      
+///      measured by Generate() and Render() already filled in                
+///   @param layers - the layers that were rendered                           
+///   @param pipes - the pipelines that were rendered                         
+void ASCIIRenderer::GatherStatistics(
+   ASCIIFrameStats& stats, const Layers& layers, const Pipelines& pipes
+) {
+   for (const auto layer : layers) {
+      const auto& scene = layer->GetPublished();
+      stats.mInstancesConsidered += scene.mInstancesConsidered;
+      stats.mInstancesDrawn += scene.mInstancesDrawn;
+      stats.mBufferBytes += layer->GetBufferBytes();
+   }
+   stats.mInstancesCulled = stats.mInstancesConsidered - stats.mInstancesDrawn;
+
+   for (const auto pipe : pipes) {
+      stats.mPipelines.Add(pipe->GetStatistics());
+      stats.mPerPipeline.emplace_back(static_cast<const void*>(pipe), pipe->GetStatistics());
+      stats.mBufferBytes += pipe->GetBufferBytes();
+   }
+
+   if (stats.mPipelines.mPixelsAssembled) {
+      stats.mOverdraw = static_cast<Real>(stats.mPipelines.mFragmentsPassed)
+                      / static_cast<Real>(stats.mPipelines.mPixelsAssembled);
+   }
+
+   for (const auto& image : mSwapchain)
+      stats.mBufferBytes += image.GetBytes();
+
+   const ::std::scoped_lock lock {mStatsMutex};
+   mStats = ::std::move(stats);
+}
 
-   // Prepare the backbuffer                                            
-   const int sizex = static_cast<int>(mWindow->GetSize().x);
-   const int sizey = static_cast<int>(mWindow->GetSize().y);
+/// Scale the resolution of all pipelines, so that the next frame fits in the 
+/// frame budget. The whole frame is measured - compiling, rendering with     
+/// shadows and compositing, and presenting. Only the time pipelines spend    
+/// depends on the resolution, so the rest is subtracted from the budget as   
+/// a fixed cost. That time is roughly proportional to the number of pixels,  
+/// and the resolution scale is per axis, so it follows the square root of    
+/// the time ratio                                                            
+///   @attention called on the caller's thread, while holding mResourceMutex, 
+///      and while the render thread is idle - the new resolution is applied  
+///      by PrepareBuffers()                                                  
+void ASCIIRenderer::ControlResolution() {
+   if (mFrameBudget <= 0) {
+      if (mControlledFrame) {
+         for (auto& pipe : mPipelines)
+            pipe.SetResolutionScale(1);
+         mControlledFrame = 0;
+      }
+      return;
+   }
+
+   // React to each rendered frame only once                            
+   Real total, scaled;
+   {
+      const ::std::scoped_lock lock {mStatsMutex};
+      if (mStats.mFrame == mControlledFrame)
+         return;
+
+      mControlledFrame = mStats.mFrame;
+      total = mStats.mGenerateTime + mStats.mRenderTime + mPresentTime;
+      scaled = mStats.mPipelines.mRenderTime + mStats.mPipelines.mAssembleTime;
+   }
+   if (scaled <= 0)
+      return;
 
-   mBackbuffer.Resize(sizex, sizey);
-   mBackbuffer.Fill(" ", Colors::White, config.mClearColor);
+   // When the fixed cost alone is over budget, the pipelines get the   
+   // lowest resolution they support, as fast as damping allows         
+   const Real available = ::std::max(mFrameBudget - (total - scaled), Real {0});
+   const Real ratio = available / scaled;
+   if (::std::abs(ratio - 1) < BudgetTolerance)
+      return;
+
+   const Real change = 1 + (::std::sqrt(ratio) - 1) * ResolutionDamping;
+   for (auto& pipe : mPipelines)
+      pipe.SetResolutionScale(pipe.GetResolutionScale() * change);
+}
+
+/// The render thread loop, used only in threaded mode                        
+/// Takes published snapshots, and renders each into the backbuffer that was  
+/// prepared for it, while the previous one is being presented                
+void ASCIIRenderer::RenderThread() {
+   while (true) {
+      RenderConfig config;
+      int image;
+      {
+         // Wait for a snapshot                                         
+         ::std::unique_lock lock {mFrameMutex};
+         mFrameSignal.wait(lock, [this] {
+            return mSnapshotPending or mQuit;
+         });
+         if (mQuit)
+            return;
 
-   if (mLayers) {
-      // Resize and clear all pipelines                                 
-      for (auto& pipe : mPipelines) {
-         pipe.Resize(sizex, sizey);
-         pipe.Clear(config.mClearColor, config.mClearDepth);
+         config = mSnapshotConfig;
+         image = mRenderingImage;
+         mSnapshotPending = false;
       }
 
-      // Render all layers                                              
-      for (const auto& layer : mLayers) {
-         layer.Render(config);
+      Render(config, mSwapchain[image]);
 
-         // Copy the result into the backbuffer                         
-         mBackbuffer.Copy(layer.mImage); //TODO assemble using stencil instead
+      {
+         // Wait for the previous frame to be presented, before queuing 
+         // this one                                                    
+         ::std::unique_lock lock {mFrameMutex};
+         mFrameSignal.wait(lock, [this] {
+            return mReadyImage < 0 or mQuit;
+         });
+         if (mQuit)
+            return;
+
+         mReadyImage = mRenderingImage;
+         mRenderingImage = -1;
       }
+      mFrameSignal.notify_all();
    }
+}
+
+/// Stop the render thread if running, and wait for it to finish              
+void ASCIIRenderer::StopRenderThread() {
+   if (not mRenderThread.joinable())
+      return;
 
-   // Send the rendered backbuffer to the window                        
-   (void) mWindow->Draw(&mBackbuffer);
+   {
+      const ::std::scoped_lock lock {mFrameMutex};
+      mQuit = true;
+   }
+   mFrameSignal.notify_all();
+   mRenderThread.join();
 }
 
 /// Get the window interface                                                  
@@ -125,7 +526,51 @@ auto ASCIIRenderer::GetWindow() const noexcept -> const A::Window* {
 ///   @return the resolution                                                  
 auto ASCIIRenderer::GetResolution() const noexcept -> Scale2 {
    return {
-      mBackbuffer.GetView().mWidth,
-      mBackbuffer.GetView().mHeight
+      mSwapchain[mPresented].GetView().mWidth,
+      mSwapchain[mPresented].GetView().mHeight
    };
 }
+
+/// Get the current frame, used to stamp content on use                       
+///   @return the number of compiled frames                                   
+auto ASCIIRenderer::GetFrame() const noexcept -> uint64_t {
+   return mFrame;
+}
+
+/// Set the memory budget for converted geometry and textures                 
+///   @param bytes - the budget in bytes                                      
+void ASCIIRenderer::SetMemoryBudget(size_t bytes) noexcept {
+   mMemoryBudget = bytes;
+}
+
+/// Set the time budget for a whole frame, that drives the resolution of all  
+/// pipelines. Takes effect when the next frame is prepared                   
+///   @param seconds - the budget, or zero to always render at the full       
+///      resolution of each pipeline's style                                  
+void ASCIIRenderer::SetFrameBudget(Real seconds) noexcept {
+   mFrameBudget = seconds;
+}
+
+/// Get the memory usage of converted content, as of the last frame           
+/// Safe to call while the render thread is running                           
+///   @return a copy of the memory statistics                                 
+auto ASCIIRenderer::GetMemoryStats() const -> ASCIIMemoryStats {
+   const ::std::scoped_lock lock {mStatsMutex};
+   return mMemoryStats;
+}
+
+/// Get the statistics of the last rendered frame                             
+/// Safe to call while the render thread is running                           
+///   @return a copy of the statistics                                        
+auto ASCIIRenderer::GetStatistics() const -> ASCIIFrameStats {
+   const ::std::scoped_lock lock {mStatsMutex};
+   auto stats = mStats;
+   stats.mPresentTime = mPresentTime;
+   return stats;
+}
+
+/// Get the last presented backbuffer                                         
+///   @return the backbuffer                                                  
+auto ASCIIRenderer::GetBackbuffer() const noexcept -> const ASCIIImage& {
+   return mSwapchain[mPresented];
+}
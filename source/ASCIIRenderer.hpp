@@ -14,6 +14,71 @@
 #include <Langulus/Verbs/Interpret.hpp>
 #include <Langulus/Math/Gradient.hpp>
 #include <Langulus/Entity/Pin.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/// Defines where a renderer does its work                                    
+enum class ASCIIRenderMode {
+   // Compile, render and present on the caller's thread                
+   Immediate = 0,
+
+   // Compile on the caller's thread, then render on a dedicated thread 
+   // into a swap chain, while the previous frame is being presented    
+   Threaded
+};
+
+
+/// Memory usage of converted content, updated on each frame                  
+struct ASCIIMemoryStats {
+   // Bytes allowed for converted content, before the least recently    
+   // used content gets evicted                                         
+   size_t mBudget = 0;
+   // Bytes used by resident geometry and textures                      
+   size_t mGeometryBytes = 0;
+   size_t mTextureBytes = 0;
+   // Number of resident, and of all converted content entries          
+   size_t mResident = 0;
+   size_t mEntries = 0;
+   // Number of entries evicted since the renderer was created          
+   size_t mEvictions = 0;
+};
+
+
+/// Work done to draw the last rendered frame                                 
+/// In threaded mode, window Draw time is of the last presented frame, which  
+/// might be the one before the last rendered frame                           
+struct ASCIIFrameStats {
+   // The frame the statistics are for, as in ASCIIRenderer::GetFrame() 
+   uint64_t mFrame = 0;
+   // Renderable instances tested for each camera and level, discarded  
+   // by culling or fog, and sent to pipelines                          
+   size_t mInstancesConsidered = 0;
+   size_t mInstancesCulled = 0;
+   size_t mInstancesDrawn = 0;
+   // Work done by all pipelines, and by each individual pipeline. A    
+   // pipeline is identified only by its address while the frame was    
+   // rendered - it might have been destroyed since, and the address    
+   // might belong to another pipeline in later frames, so it's never   
+   // to be dereferenced, or compared across frames                     
+   ASCIIPipelineStats mPipelines;
+   ::std::vector<::std::pair<const void*, ASCIIPipelineStats>> mPerPipeline;
+   // Fragments that passed the depth test, per assembled pixel         
+   Real mOverdraw = 0;
+   // Seconds spent compiling layers, rendering the frame as a whole,   
+   // compositing layers into the backbuffer, and presenting the        
+   // backbuffer in the window. Rendering includes pipelines, shadows,  
+   // and compositing                                                   
+   Real mGenerateTime = 0;
+   Real mRenderTime = 0;
+   Real mCompositeTime = 0;
+   Real mPresentTime = 0;
+   // Bytes allocated for backbuffers, pipeline and layer buffers, and  
+   // cached shadowmaps                                                 
+   size_t mBufferBytes = 0;
+};
 
 
 ///                                                                           
@@ -56,8 +121,86 @@ protected:
    // Texture content mirror                                            
    TFactoryUnique<ASCIITexture> mTextures;
 
-   // Backbuffer                                                        
-   ASCIIImage mBackbuffer;
+   // Converted geometry and textures, that weren't used recently, are  
+   // evicted when their total size goes above this budget              
+   static constexpr size_t DefaultMemoryBudget = 256 * 1024 * 1024;
+   size_t mMemoryBudget = DefaultMemoryBudget;
+   // Written only by the caller's thread, guarded by mStatsMutex       
+   ASCIIMemoryStats mMemoryStats;
+   // Versions of the geometry evicted since the last PrepareBuffers()  
+   // Pipelines forget lighting baked for them there, while the render  
+   // thread is idle                                                    
+   ::std::vector<uint64_t> mEvictedGeometry;
+   // Incremented on each Generate(), content is stamped with it on use 
+   uint64_t mFrame = 0;
+
+   // Time in seconds that a whole frame may take - compiling, rendering
+   // and presenting it. If frames go over it, or well under it, the    
+   // resolution of the pipelines is scaled for the next frame. Zero    
+   // disables dynamic resolution                                       
+   Real mFrameBudget = 0;
+   // The last frame, whose statistics drove the resolution             
+   uint64_t mControlledFrame = 0;
+   // Budget ratio, inside of which the resolution isn't changed, so    
+   // that it doesn't oscillate around the budget                       
+   static constexpr Real BudgetTolerance = 0.15;
+   // Fraction of the estimated change that is applied each frame       
+   static constexpr Real ResolutionDamping = 0.5;
+
+   // Swap chain of backbuffers. One is presented, one might be waiting 
+   // to be presented, and one might be rendered by the render thread   
+   static constexpr int SwapchainSize = 3;
+   ASCIIImage mSwapchain[SwapchainSize];
+   // Index of the backbuffer that was last presented                   
+   int mPresented = 0;
+
+   // Immediate mode state, between Prepare(), Render() and Present()   
+   // Set when a frame was compiled, and has to be rendered & presented 
+   bool mFramePending = false;
+   // The configuration of that frame                                   
+   RenderConfig mFrameConfig;
+
+   //                                                                   
+   // Threaded mode state, all guarded by mFrameMutex                   
+   //                                                                   
+   ASCIIRenderMode mRenderMode = ASCIIRenderMode::Immediate;
+   ::std::thread mRenderThread;
+   ::std::mutex mFrameMutex;
+   ::std::condition_variable mFrameSignal;
+   // Set when layers contain a published scene not yet taken for render
+   bool mSnapshotPending = false;
+   // The configuration of the pending scene                            
+   RenderConfig mSnapshotConfig;
+   // Index of a rendered backbuffer, waiting to be presented, or -1    
+   int mReadyImage = -1;
+   // Index of the backbuffer handed to the render thread, or -1 after  
+   // it is rendered. Buffers are prepared only while this is -1        
+   int mRenderingImage = -1;
+   // Set to stop the render thread                                     
+   bool mQuit = false;
+
+   // Guards layer and pipeline factories, while they are changed or    
+   // iterated on different threads                                     
+   ::std::mutex mResourceMutex;
+
+   // Statistics of the last rendered frame, and the time of the last   
+   // window Draw, both guarded by mStatsMutex                          
+   mutable ::std::mutex mStatsMutex;
+   ASCIIFrameStats mStats;
+   Real mPresentTime = 0;
+
+   using Layers = ::std::vector<ASCIILayer*>;
+   using Pipelines = ::std::vector<ASCIIPipeline*>;
+
+   auto Generate() -> RenderConfig;
+   void PrepareBuffers(const RenderConfig&, ASCIIImage&);
+   void Render(const RenderConfig&, ASCIIImage&);
+   void RenderThread();
+   void StopRenderThread();
+   void EvictContent();
+   void ControlResolution();
+   void GatherStatistics(ASCIIFrameStats&, const Layers&, const Pipelines&);
+   void DrawWindow();
 
 public:
    ASCIIRenderer(ASCII*, const Many&);
@@ -69,6 +212,17 @@ public:
    void Refresh() override;
    void Draw();
 
+   void Prepare();
+   void Render();
+   void Present();
+
    auto GetWindow() const noexcept -> const A::Window*;
    auto GetResolution() const noexcept -> Scale2;
+   auto GetBackbuffer() const noexcept -> const ASCIIImage&;
+   auto GetFrame() const noexcept -> uint64_t;
+
+   void SetMemoryBudget(size_t) noexcept;
+   void SetFrameBudget(Real) noexcept;
+   auto GetMemoryStats() const -> ASCIIMemoryStats;
+   auto GetStatistics() const -> ASCIIFrameStats;
 };
@@ -10,6 +10,7 @@
 #include <Langulus/Material.hpp>
 #include <Langulus/Graphics.hpp>
 #include <Langulus/Platform.hpp>
+#include <chrono>
 
 LANGULUS_EXCEPTION(Graphics);
 
@@ -25,6 +26,18 @@ struct ASCIIRenderable;
 struct ASCIIPipeline;
 struct ASCIIImage;
 
+
+/// Adds the time spent in a scope to a counter, in seconds                   
+struct RenderTimer {
+   Real& mTotal;
+   ::std::chrono::steady_clock::time_point mStart = ::std::chrono::steady_clock::now();
+
+   ~RenderTimer() {
+      mTotal += ::std::chrono::duration<Real>(
+         ::std::chrono::steady_clock::now() - mStart).count();
+   }
+};
+
 #if 1
    #define VERBOSE_ASCII_ENABLED()  1
    #define VERBOSE_ASCII(...)       Logger::Verbose(Self(), __VA_ARGS__)
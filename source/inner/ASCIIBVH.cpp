@@ -0,0 +1,341 @@
+///                                                                           
+/// Langulus::Module::ASCII                                                   
+/// Copyright (c) 2024 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "ASCIIBVH.hpp"
+
+
+/// Transform the box, and get the axis aligned box around the result         
+///   @param transform - the transformation to apply                          
+///   @return the transformed box                                             
+auto ASCIIBounds::Transform(const Mat4& transform) const noexcept -> ASCIIBounds {
+   ASCIIBounds result;
+   for (int i = 0; i < 8; ++i) {
+      const Vec4 corner = transform * Vec4 {
+         i & 1 ? mMax.x : mMin.x,
+         i & 2 ? mMax.y : mMin.y,
+         i & 4 ? mMax.z : mMin.z,
+         1
+      };
+
+      const Vec3 p {corner.x, corner.y, corner.z};
+      if (i == 0)
+         result = {p, p};
+      else
+         result = result.Merge({p, p});
+   }
+   return result;
+}
+
+/// Check if the box is completely outside of a frustum                       
+/// The corners are projected in clip space, and the box is outside only if   
+/// all of them are on the wrong side of the same clipping plane. This is     
+/// conservative - some boxes near the frustum corners will pass              
+///   @param projectedView - the frustum, as a view-projection matrix         
+///   @return true if the box is definitely not visible                       
+bool ASCIIBounds::IsOutside(const Mat4& projectedView) const noexcept {
+   // Each bit marks a plane, which all corners have been outside of    
+   int outside = 0b1111111;
+   for (int i = 0; i < 8 and outside; ++i) {
+      const Vec4 p = projectedView * Vec4 {
+         i & 1 ? mMax.x : mMin.x,
+         i & 2 ? mMax.y : mMin.y,
+         i & 4 ? mMax.z : mMin.z,
+         1
+      };
+
+      int corner = 0;
+      if (p.x < -p.w) corner |= 1 << 0;
+      if (p.x >  p.w) corner |= 1 << 1;
+      if (p.y < -p.w) corner |= 1 << 2;
+      if (p.y >  p.w) corner |= 1 << 3;
+      if (p.z < -p.w) corner |= 1 << 4;
+      if (p.z >  p.w) corner |= 1 << 5;
+      if (p.w <= 0)   corner |= 1 << 6;
+      outside &= corner;
+   }
+   return outside != 0;
+}
+
+/// Get the box around a frustum, by unprojecting the corners of clip space   
+///   @param projectedView - the frustum, as a view-projection matrix         
+///   @param far - depth of the far plane in normalized device coordinates,   
+///      so that the frustum can be cut short of the projection's far plane   
+///   @return the box containing the whole frustum                            
+auto ASCIIBounds::Frustum(const Mat4& projectedView, Real far) noexcept -> ASCIIBounds {
+   const Mat4 unproject = projectedView.Invert();
+   ASCIIBounds result;
+   for (int i = 0; i < 8; ++i) {
+      const Vec4 corner = unproject * Vec4 {
+         i & 1 ? 1 : -1,
+         i & 2 ? 1 : -1,
+         i & 4 ? far : -1,
+         1
+      };
+
+      const Vec3 p = Vec3 {corner.x, corner.y, corner.z} / corner.w;
+      if (i == 0)
+         result = {p, p};
+      else
+         result = result.Merge({p, p});
+   }
+   return result;
+}
+
+/// Get a node from the free list, or allocate a new one                      
+///   @return the node index                                                  
+int ASCIIBVH::AllocateNode() {
+   if (mFree == Null) {
+      mNodes.emplace_back();
+      mNodes.back().mHeight = 0;
+      return static_cast<int>(mNodes.size() - 1);
+   }
+
+   const int index = mFree;
+   mFree = mNodes[index].mParent;
+   mNodes[index] = {};
+   mNodes[index].mHeight = 0;
+   return index;
+}
+
+/// Return a node to the free list                                            
+///   @param index - the node index                                           
+void ASCIIBVH::FreeNode(int index) {
+   mNodes[index].mParent = mFree;
+   mNodes[index].mHeight = -1;
+   mFree = index;
+}
+
+/// Create a proxy                                                            
+///   @param bounds - the tight bounds of the proxy, they will be fattened    
+///   @param value - the user value to report when querying                   
+///   @return the proxy handle                                                
+int ASCIIBVH::CreateProxy(const ASCIIBounds& bounds, size_t value) {
+   const int index = AllocateNode();
+   mNodes[index].mBounds = bounds.Fatten(Margin);
+   mNodes[index].mValue = value;
+   InsertLeaf(index);
+   ++mProxyCount;
+   return index;
+}
+
+/// Destroy a proxy                                                           
+///   @param proxy - the proxy handle                                         
+void ASCIIBVH::DestroyProxy(int proxy) {
+   LANGULUS_ASSUME(DevAssumes, mNodes[proxy].IsLeaf(), "Not a proxy");
+   RemoveLeaf(proxy);
+   FreeNode(proxy);
+   --mProxyCount;
+}
+
+/// Update the bounds of a proxy, reinserting it only if it left its          
+/// fattened bounds                                                           
+///   @param proxy - the proxy handle                                         
+///   @param bounds - the new tight bounds                                    
+///   @return true if the tree was modified                                   
+bool ASCIIBVH::MoveProxy(int proxy, const ASCIIBounds& bounds) {
+   LANGULUS_ASSUME(DevAssumes, mNodes[proxy].IsLeaf(), "Not a proxy");
+   if (mNodes[proxy].mBounds.Contains(bounds))
+      return false;
+
+   RemoveLeaf(proxy);
+   mNodes[proxy].mBounds = bounds.Fatten(Margin);
+   InsertLeaf(proxy);
+   return true;
+}
+
+/// Change the user value of a proxy                                          
+///   @param proxy - the proxy handle                                         
+///   @param value - the new value                                            
+void ASCIIBVH::SetValue(int proxy, size_t value) noexcept {
+   mNodes[proxy].mValue = value;
+}
+
+/// Get the user value of a proxy                                             
+///   @param proxy - the proxy handle                                         
+///   @return the value                                                       
+auto ASCIIBVH::GetValue(int proxy) const noexcept -> size_t {
+   return mNodes[proxy].mValue;
+}
+
+/// Get the number of proxies in the tree                                     
+///   @return the number of proxies                                           
+auto ASCIIBVH::GetProxyCount() const noexcept -> size_t {
+   return mProxyCount;
+}
+
+/// Remove all proxies, invalidating all handles                              
+void ASCIIBVH::Clear() {
+   mNodes.clear();
+   mRoot = Null;
+   mFree = Null;
+   mProxyCount = 0;
+}
+
+/// Insert a leaf, choosing the sibling that increases the total surface      
+/// area the least, and rebalance the tree on the way back up                 
+///   @param leaf - the leaf node index                                       
+void ASCIIBVH::InsertLeaf(int leaf) {
+   if (mRoot == Null) {
+      mRoot = leaf;
+      mNodes[leaf].mParent = Null;
+      return;
+   }
+
+   // Find the best sibling                                             
+   const auto leafBounds = mNodes[leaf].mBounds;
+   int index = mRoot;
+   while (not mNodes[index].IsLeaf()) {
+      const auto& node = mNodes[index];
+      const Real area = node.mBounds.GetCost();
+      const Real combined = node.mBounds.Merge(leafBounds).GetCost();
+
+      // Cost of creating a new parent for this node and the leaf, and  
+      // the minimum cost of pushing the leaf further down              
+      const Real cost = 2 * combined;
+      const Real inherited = 2 * (combined - area);
+
+      auto descend = [&](int child) {
+         const auto& c = mNodes[child];
+         const Real merged = c.mBounds.Merge(leafBounds).GetCost();
+         return c.IsLeaf()
+            ? merged + inherited
+            : merged - c.mBounds.GetCost() + inherited;
+      };
+
+      const Real costLeft = descend(node.mLeft);
+      const Real costRight = descend(node.mRight);
+      if (cost < costLeft and cost < costRight)
+         break;
+
+      index = costLeft < costRight ? node.mLeft : node.mRight;
+   }
+
+   // Create a new parent for the sibling and the leaf                  
+   const int sibling = index;
+   const int oldParent = mNodes[sibling].mParent;
+   const int newParent = AllocateNode();
+   mNodes[newParent].mParent = oldParent;
+   mNodes[newParent].mBounds = leafBounds.Merge(mNodes[sibling].mBounds);
+   mNodes[newParent].mHeight = mNodes[sibling].mHeight + 1;
+   mNodes[newParent].mLeft = sibling;
+   mNodes[newParent].mRight = leaf;
+   mNodes[sibling].mParent = newParent;
+   mNodes[leaf].mParent = newParent;
+
+   if (oldParent == Null)
+      mRoot = newParent;
+   else if (mNodes[oldParent].mLeft == sibling)
+      mNodes[oldParent].mLeft = newParent;
+   else
+      mNodes[oldParent].mRight = newParent;
+
+   // Walk back up, refitting and rebalancing                           
+   index = mNodes[leaf].mParent;
+   while (index != Null) {
+      index = Balance(index);
+      auto& node = mNodes[index];
+      node.mHeight = 1 + ::std::max(
+         mNodes[node.mLeft].mHeight, mNodes[node.mRight].mHeight);
+      node.mBounds = mNodes[node.mLeft].mBounds.Merge(mNodes[node.mRight].mBounds);
+      index = node.mParent;
+   }
+}
+
+/// Remove a leaf, replacing its parent with its sibling                      
+///   @param leaf - the leaf node index                                       
+void ASCIIBVH::RemoveLeaf(int leaf) {
+   if (leaf == mRoot) {
+      mRoot = Null;
+      return;
+   }
+
+   const int parent = mNodes[leaf].mParent;
+   const int grandParent = mNodes[parent].mParent;
+   const int sibling = mNodes[parent].mLeft == leaf
+      ? mNodes[parent].mRight
+      : mNodes[parent].mLeft;
+
+   FreeNode(parent);
+   mNodes[sibling].mParent = grandParent;
+
+   if (grandParent == Null) {
+      mRoot = sibling;
+      return;
+   }
+
+   if (mNodes[grandParent].mLeft == parent)
+      mNodes[grandParent].mLeft = sibling;
+   else
+      mNodes[grandParent].mRight = sibling;
+
+   // Walk back up, refitting and rebalancing                           
+   int index = grandParent;
+   while (index != Null) {
+      index = Balance(index);
+      auto& node = mNodes[index];
+      node.mHeight = 1 + ::std::max(
+         mNodes[node.mLeft].mHeight, mNodes[node.mRight].mHeight);
+      node.mBounds = mNodes[node.mLeft].mBounds.Merge(mNodes[node.mRight].mBounds);
+      index = node.mParent;
+   }
+}
+
+/// Perform a left or right rotation if the node is imbalanced                
+///   @param a - the node to balance                                          
+///   @return the node that took a's place                                    
+int ASCIIBVH::Balance(int a) {
+   if (mNodes[a].IsLeaf() or mNodes[a].mHeight < 2)
+      return a;
+
+   const int b = mNodes[a].mLeft;
+   const int c = mNodes[a].mRight;
+   const int balance = mNodes[c].mHeight - mNodes[b].mHeight;
+
+   // Rotate the taller child up. The taller child's taller child stays 
+   // under it, while its shorter child is handed over to a             
+   auto rotate = [&](int up, int other, bool upIsRight) {
+      const int f = mNodes[up].mLeft;
+      const int g = mNodes[up].mRight;
+
+      // Swap a and up                                                  
+      mNodes[up].mLeft = a;
+      mNodes[up].mParent = mNodes[a].mParent;
+      mNodes[a].mParent = up;
+
+      if (mNodes[up].mParent != Null) {
+         auto& parent = mNodes[mNodes[up].mParent];
+         if (parent.mLeft == a)
+            parent.mLeft = up;
+         else
+            parent.mRight = up;
+      }
+      else mRoot = up;
+
+      const bool fTaller = mNodes[f].mHeight > mNodes[g].mHeight;
+      const int keep = fTaller ? f : g;
+      const int give = fTaller ? g : f;
+
+      mNodes[up].mRight = keep;
+      if (upIsRight)
+         mNodes[a].mRight = give;
+      else
+         mNodes[a].mLeft = give;
+      mNodes[give].mParent = a;
+
+      mNodes[a].mBounds = mNodes[other].mBounds.Merge(mNodes[give].mBounds);
+      mNodes[up].mBounds = mNodes[a].mBounds.Merge(mNodes[keep].mBounds);
+      mNodes[a].mHeight = 1 + ::std::max(mNodes[other].mHeight, mNodes[give].mHeight);
+      mNodes[up].mHeight = 1 + ::std::max(mNodes[a].mHeight, mNodes[keep].mHeight);
+      return up;
+   };
+
+   if (balance > 1)
+      return rotate(c, b, true);
+   if (balance < -1)
+      return rotate(b, c, false);
+   return a;
+}
@@ -0,0 +1,197 @@
+///                                                                           
+/// Langulus::Module::ASCII                                                   
+/// Copyright (c) 2024 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "../Common.hpp"
+#include <algorithm>
+#include <concepts>
+#include <vector>
+
+
+///                                                                           
+///   An axis aligned bounding box                                            
+///                                                                           
+struct ASCIIBounds {
+   Vec3 mMin;
+   Vec3 mMax;
+
+   /// Get the smallest box containing both boxes                             
+   ///   @param other - the box to merge with                                 
+   ///   @return the merged box                                               
+   auto Merge(const ASCIIBounds& other) const noexcept -> ASCIIBounds {
+      return {
+         Vec3 {
+            ::std::min(mMin.x, other.mMin.x),
+            ::std::min(mMin.y, other.mMin.y),
+            ::std::min(mMin.z, other.mMin.z)
+         },
+         Vec3 {
+            ::std::max(mMax.x, other.mMax.x),
+            ::std::max(mMax.y, other.mMax.y),
+            ::std::max(mMax.z, other.mMax.z)
+         }
+      };
+   }
+
+   /// Get the box shared by both boxes                                       
+   ///   @param other - the box to intersect with                             
+   ///   @return the intersection, which is empty if the boxes don't overlap  
+   auto Intersect(const ASCIIBounds& other) const noexcept -> ASCIIBounds {
+      return {
+         Vec3 {
+            ::std::max(mMin.x, other.mMin.x),
+            ::std::max(mMin.y, other.mMin.y),
+            ::std::max(mMin.z, other.mMin.z)
+         },
+         Vec3 {
+            ::std::min(mMax.x, other.mMax.x),
+            ::std::min(mMax.y, other.mMax.y),
+            ::std::min(mMax.z, other.mMax.z)
+         }
+      };
+   }
+
+   /// Check if the box contains no points                                    
+   ///   @return true if the box is inverted along any axis                   
+   bool IsEmpty() const noexcept {
+      return mMin.x > mMax.x or mMin.y > mMax.y or mMin.z > mMax.z;
+   }
+
+   /// Check if another box is fully inside this one                          
+   ///   @param other - the box to test                                       
+   ///   @return true if other is contained                                   
+   bool Contains(const ASCIIBounds& other) const noexcept {
+      return mMin.x <= other.mMin.x and mMax.x >= other.mMax.x
+         and mMin.y <= other.mMin.y and mMax.y >= other.mMax.y
+         and mMin.z <= other.mMin.z and mMax.z >= other.mMax.z;
+   }
+
+   /// Check if two boxes overlap                                             
+   ///   @param other - the box to test                                       
+   ///   @return true if the boxes share at least one point                   
+   bool Intersects(const ASCIIBounds& other) const noexcept {
+      return mMin.x <= other.mMax.x and mMax.x >= other.mMin.x
+         and mMin.y <= other.mMax.y and mMax.y >= other.mMin.y
+         and mMin.z <= other.mMax.z and mMax.z >= other.mMin.z;
+   }
+
+   /// Grow the box by a fraction of its size on each side                    
+   ///   @param fraction - how much to grow, relative to the extent           
+   ///   @return the grown box                                                
+   auto Fatten(Real fraction) const noexcept -> ASCIIBounds {
+      const Vec3 margin = (mMax - mMin) * fraction;
+      return {mMin - margin, mMax + margin};
+   }
+
+   /// Get half the surface area, used as a cost heuristic when building      
+   ///   @return the half area                                                
+   auto GetCost() const noexcept -> Real {
+      const Vec3 d = mMax - mMin;
+      return d.x * d.y + d.y * d.z + d.z * d.x;
+   }
+
+   auto Transform(const Mat4&) const noexcept -> ASCIIBounds;
+   bool IsOutside(const Mat4&) const noexcept;
+
+   static auto Frustum(const Mat4&, Real far = 1) noexcept -> ASCIIBounds;
+};
+
+
+///                                                                           
+///   Dynamic bounding volume hierarchy                                       
+///                                                                           
+///   A binary tree of fattened boxes, that can be updated incrementally as   
+/// its contents move. Moving a proxy only touches the tree when it leaves    
+/// its fattened box, so small movements cost nothing. Each proxy carries a   
+/// user value, which is reported back when querying.                         
+///                                                                           
+struct ASCIIBVH {
+   static constexpr int Null = -1;
+
+private:
+   struct Node {
+      // Fattened bounds for leaves, merged bounds for branches         
+      ASCIIBounds mBounds;
+      // Parent node, or the next free node if in the free list         
+      int mParent = Null;
+      int mLeft = Null;
+      int mRight = Null;
+      // Leaves have height 0, free nodes have height -1                
+      int mHeight = -1;
+      // User value, reported when querying leaves                      
+      size_t mValue = 0;
+
+      bool IsLeaf() const noexcept { return mLeft == Null; }
+   };
+
+   ::std::vector<Node> mNodes;
+   int mRoot = Null;
+   int mFree = Null;
+   size_t mProxyCount = 0;
+
+   // How much proxies are fattened, relative to their size             
+   static constexpr Real Margin = 0.1;
+
+   int AllocateNode();
+   void FreeNode(int);
+   void InsertLeaf(int);
+   void RemoveLeaf(int);
+   int Balance(int);
+
+public:
+   int CreateProxy(const ASCIIBounds&, size_t value);
+   void DestroyProxy(int);
+   bool MoveProxy(int, const ASCIIBounds&);
+   void SetValue(int, size_t) noexcept;
+   auto GetValue(int) const noexcept -> size_t;
+   auto GetProxyCount() const noexcept -> size_t;
+   void Clear();
+
+   /// Report the values of all proxies, whose fattened bounds aren't         
+   /// completely outside of a frustum                                        
+   ///   @param projectedView - the frustum, as a view-projection matrix      
+   ///   @param call - invoked with the value of each potentially visible     
+   ///      proxy                                                             
+   template<class F>
+   void Query(const Mat4& projectedView, F&& call) const {
+      Query([&projectedView](const ASCIIBounds& bounds) {
+         return bounds.IsOutside(projectedView);
+      }, ::std::forward<F>(call));
+   }
+
+   /// Report the values of all proxies, whose fattened bounds aren't         
+   /// rejected by a test. The test is applied to branches, too, so it must   
+   /// reject a box only if it rejects everything inside it                   
+   ///   @param rejects - returns true for bounds that can be skipped         
+   ///   @param call - invoked with the value of each accepted proxy          
+   template<class T, class F> requires ::std::predicate<T&, const ASCIIBounds&>
+   void Query(T&& rejects, F&& call) const {
+      if (mRoot == Null)
+         return;
+
+      // The tree is kept balanced, so its height is logarithmic, and   
+      // a depth-first traversal never needs more than height+1 slots   
+      int stack[64];
+      int top = 0;
+      stack[top++] = mRoot;
+
+      while (top) {
+         const auto& node = mNodes[stack[--top]];
+         if (rejects(node.mBounds))
+            continue;
+
+         if (node.IsLeaf()) {
+            call(node.mValue);
+            continue;
+         }
+
+         LANGULUS_ASSUME(DevAssumes, top + 2 <= 64, "BVH is too deep");
+         stack[top++] = node.mRight;
+         stack[top++] = node.mLeft;
+      }
+   }
+};
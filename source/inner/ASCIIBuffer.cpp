@@ -26,6 +26,7 @@ ASCIIImage::ASCIIImage(ASCIIRenderer* renderer)
 /// Reset the image                                                           
 void ASCIIImage::Reset() {
    mView = {};
+   mCapacity = {};
    mDataListMap.Reset();
    mSymbols.Reset();
    mBgColors.Reset();
@@ -33,16 +34,29 @@ void ASCIIImage::Reset() {
    mStyle.Reset();
 }
 
-/// Resize the image                                                          
+/// Resize the image, reusing storage if the new size fits in capacity        
+/// Pixels inside both the old and new size are preserved, and the newly      
+/// exposed area is cleared                                                   
 ///   @param x - new width                                                    
 ///   @param y - new height                                                   
 void ASCIIImage::Resize(int x, int y) {
    LANGULUS_ASSUME(DevAssumes, x and y, "Invalid resize dimensions");
-   if (x == static_cast<int>(mView.mWidth)
-   and y == static_cast<int>(mView.mHeight))
+   const int oldx = GetWidth();
+   const int oldy = GetHeight();
+   if (x == oldx and y == oldy)
       return;
 
-   const auto count = x * y;
+   mView.mWidth  = static_cast<uint32_t>(x);
+   mView.mHeight = static_cast<uint32_t>(y);
+
+   if (mCapacity.Fits(x, y)) {
+      Fill({oldx, 0, x - oldx, ::std::min(oldy, y)}, " ");
+      Fill({0, oldy, x, y - oldy}, " ");
+      return;
+   }
+
+   mCapacity = ASCIICapacity::For(x, y);
+   const auto count = mCapacity.GetCount();
    mSymbols.Clear();
    mSymbols.New(count, " ");
 
@@ -54,9 +68,6 @@ void ASCIIImage::Resize(int x, int y) {
 
    mStyle.Clear();
    mStyle.New(count);
-
-   mView.mWidth  = static_cast<uint32_t>(x);
-   mView.mHeight = static_cast<uint32_t>(y);
 }
 
 /// Get a pixel at coordinates x, y                                           
@@ -69,7 +80,7 @@ ASCIIImage::Pixel ASCIIImage::GetPixel(int x, int y) const {
    LANGULUS_ASSUME(DevAssumes, y < static_cast<int>(mView.mHeight) and y >= 0,
       "Pixel out of vertical limits");
 
-   const auto index = y * static_cast<int>(mView.mWidth) + x;
+   const auto index = y * mCapacity.mStride + x;
    return {
       mSymbols[index],
       mFgColors[index],
@@ -78,16 +89,80 @@ ASCIIImage::Pixel ASCIIImage::GetPixel(int x, int y) const {
    };
 }
 
+/// Get a row of pixels, as a contiguous span for each of the planes          
+///   @param y - the row index                                                
+///   @return the row interface                                               
+auto ASCIIImage::GetRow(int y) const -> Row {
+   LANGULUS_ASSUME(DevAssumes, y < static_cast<int>(mView.mHeight) and y >= 0,
+      "Row out of vertical limits");
+
+   const auto offset = y * mCapacity.mStride;
+   const auto width  = static_cast<size_t>(mView.mWidth);
+   return {
+      {mSymbols.GetRaw()  + offset, width},
+      {mFgColors.GetRaw() + offset, width},
+      {mBgColors.GetRaw() + offset, width},
+      {mStyle.GetRaw()    + offset, width}
+   };
+}
+
+/// Get the image width in pixels                                             
+auto ASCIIImage::GetWidth() const noexcept -> int {
+   return static_cast<int>(mView.mWidth);
+}
+
+/// Get the image height in pixels                                            
+auto ASCIIImage::GetHeight() const noexcept -> int {
+   return static_cast<int>(mView.mHeight);
+}
+
+/// Get the distance between rows, in pixels                                  
+auto ASCIIImage::GetStride() const noexcept -> int {
+   return mCapacity.mStride;
+}
+
+/// Get the full rectangle of the image                                       
+auto ASCIIImage::GetRect() const noexcept -> ASCIIRect {
+   return {0, 0, GetWidth(), GetHeight()};
+}
+
+/// Get the allocated size of all planes, including the retained capacity     
+auto ASCIIImage::GetBytes() const noexcept -> size_t {
+   return static_cast<size_t>(mCapacity.GetCount())
+      * (sizeof(Token) + 2 * sizeof(RGBAf) + sizeof(Style));
+}
+
 /// Fill the image with a single symbol and style                             
 ///   @param s - the symbol that will be displayed everywhere                 
 ///   @param fg - the color that will be used for the background              
 ///   @param bg - the color that will be used for the foreground              
 ///   @param f - the emphasis that will be used                               
 void ASCIIImage::Fill(::std::string_view s, RGBAf fg, RGBAf bg, Style f) {
-   mSymbols.Fill(s);
-   mFgColors.Fill(fg);
-   mBgColors.Fill(bg);
-   mStyle.Fill(f);
+   // Fill all rows as a single block, along with the padding between   
+   const auto count = mCapacity.GetSpan(GetWidth(), GetHeight());
+   ::std::fill_n(mSymbols.GetRaw(),  count, s);
+   ::std::fill_n(mFgColors.GetRaw(), count, fg);
+   ::std::fill_n(mBgColors.GetRaw(), count, bg);
+   ::std::fill_n(mStyle.GetRaw(),    count, f);
+}
+
+/// Fill a rectangle of the image with a single symbol and style              
+///   @param rect - the rectangle to fill, clipped to the image               
+///   @param s - the symbol that will be displayed in the rectangle           
+///   @param fg - the color that will be used for the foreground              
+///   @param bg - the color that will be used for the background              
+///   @param f - the emphasis that will be used                               
+void ASCIIImage::Fill(
+   const ASCIIRect& rect, ::std::string_view s, RGBAf fg, RGBAf bg, Style f
+) {
+   const auto r = rect.Clip(GetWidth(), GetHeight());
+   for (int y = r.mY; y < r.mY + r.mHeight; ++y) {
+      const auto row = GetRow(y);
+      ::std::fill_n(row.mSymbols.data()  + r.mX, r.mWidth, s);
+      ::std::fill_n(row.mFgColors.data() + r.mX, r.mWidth, fg);
+      ::std::fill_n(row.mBgColors.data() + r.mX, r.mWidth, bg);
+      ::std::fill_n(row.mStyle.data()    + r.mX, r.mWidth, f);
+   }
 }
 
 /// Iterate all pixels using the local Pixel representation                   
@@ -102,14 +177,19 @@ auto ASCIIImage::ForEachPixel(auto&& call) const {
       "Pixel iterator must be constant ASCIIImage::Pixel reference");
 
    [[maybe_unused]] Count counter = 0;
-   for (uint32_t y = 0; y < mView.mHeight; ++y) {
-      for (uint32_t x = 0; x < mView.mWidth; ++x) {
+   for (int y = 0; y < GetHeight(); ++y) {
+      const auto row = GetRow(y);
+      for (size_t x = 0; x < row.mSymbols.size(); ++x) {
+         const Pixel pixel {
+            row.mSymbols[x], row.mFgColors[x], row.mBgColors[x], row.mStyle[x]
+         };
+
          if constexpr (CT::Bool<R>) {
-            if (not call(GetPixel(x, y)))
+            if (not call(pixel))
                return counter;
             ++counter;
          }
-         else call(GetPixel(x, y));
+         else call(pixel);
       }
    }
 
@@ -134,12 +214,7 @@ void ASCIIImage::Compare(Verb& verb) const {
             ? RGBA (cast[2], cast[1], cast[0], cast[3])
             : cast;
 
-         const auto matches = ForEachPixel(
-            [&color](const Pixel& pixel) noexcept -> bool {
-               return pixel == color;
-            });
-
-         verb << (matches == mView.GetPixelCount()
+         verb << (MatchesColor(color)
             ? Compared::Equal
             : Compared::Unequal);
       }
@@ -168,8 +243,7 @@ bool ASCIIImage::CompareInner(const A::Image& rhs) const {
    if (rhs.GetView() == GetView()
    and dynamic_cast<const ASCIIImage*>(&rhs)) {
       // We can batch-compare - both images are ASCII                   
-      TODO(); //this will actually fail because we keep pointers in the data map - i think it would be best if we add ASCII image support directly in the image module
-      return GetDataListMap() == rhs.GetDataListMap();
+      return Matches(static_cast<const ASCIIImage&>(rhs));
    }
    else if (rhs.GetView().mHeight == GetView().mHeight
    and rhs.GetView().mWidth  == GetView().mWidth) {
@@ -184,17 +258,298 @@ bool ASCIIImage::CompareInner(const A::Image& rhs) const {
    return false;
 }
 
-/// Copy another image                                                        
+/// Check if all pixels match another ASCII image plane by plane              
+///   @param rhs - the image to compare against                               
+///   @return true if sizes and all pixels match                              
+bool ASCIIImage::Matches(const ASCIIImage& rhs) const {
+   if (GetWidth() != rhs.GetWidth() or GetHeight() != rhs.GetHeight())
+      return false;
+
+   // Compare planes one by one, cheapest first                         
+   auto equal = [](const auto& a, const auto& b) {
+      return ::std::equal(a.begin(), a.end(), b.begin());
+   };
+
+   for (int y = 0; y < GetHeight(); ++y) {
+      const auto lhsRow = GetRow(y);
+      const auto rhsRow = rhs.GetRow(y);
+      if (not equal(lhsRow.mStyle,    rhsRow.mStyle)
+      or  not equal(lhsRow.mBgColors, rhsRow.mBgColors)
+      or  not equal(lhsRow.mFgColors, rhsRow.mFgColors)
+      or  not equal(lhsRow.mSymbols,  rhsRow.mSymbols))
+         return false;
+   }
+
+   return true;
+}
+
+/// Check if the image is an empty field of a uniform true color              
+///   @param color - the color to compare against                             
+///   @return true if all pixels are empty and have the given background      
+bool ASCIIImage::MatchesColor(const RGBAf& color) const {
+   for (int y = 0; y < GetHeight(); ++y) {
+      const auto row = GetRow(y);
+      for (size_t x = 0; x < row.mSymbols.size(); ++x) {
+         if (row.mSymbols[x] != " " or row.mBgColors[x] != color)
+            return false;
+      }
+   }
+
+   return true;
+}
+
+/// Copy another image of the same size                                       
+/// Each plane is contiguous, so this is four block copies, as long as both   
+/// images have the same stride                                               
 ///   @param other - the image to copy                                        
 void ASCIIImage::Copy(const ASCIIImage& other) {
-   for (uint32_t y = 0; y < GetView().mHeight; ++y) {
-      for (uint32_t x = 0; x < GetView().mWidth; ++x) {
-         auto to = GetPixel(x, y);
-         auto from = other.GetPixel(x, y);
-         to.mSymbol  = from.mSymbol;
-         to.mBgColor = from.mBgColor;
-         to.mFgColor = from.mFgColor;
-         to.mStyle   = from.mStyle;
+   LANGULUS_ASSUME(DevAssumes, GetWidth()  == other.GetWidth()
+                           and GetHeight() == other.GetHeight(),
+      "Image size mismatch");
+
+   if (GetStride() != other.GetStride())
+      return Copy(other, GetRect());
+
+   const auto count = mCapacity.GetSpan(GetWidth(), GetHeight());
+   ::std::copy_n(other.mSymbols.GetRaw(),  count, mSymbols.GetRaw());
+   ::std::copy_n(other.mFgColors.GetRaw(), count, mFgColors.GetRaw());
+   ::std::copy_n(other.mBgColors.GetRaw(), count, mBgColors.GetRaw());
+   ::std::copy_n(other.mStyle.GetRaw(),    count, mStyle.GetRaw());
+}
+
+/// Copy a rectangle from another image, at the same coordinates              
+///   @param other - the image to copy from                                   
+///   @param rect - the rectangle to copy, clipped to both images             
+void ASCIIImage::Copy(const ASCIIImage& other, const ASCIIRect& rect) {
+   const auto r = rect
+      .Clip(GetWidth(), GetHeight())
+      .Clip(other.GetWidth(), other.GetHeight());
+
+   for (int y = r.mY; y < r.mY + r.mHeight; ++y) {
+      const auto from = other.GetRow(y);
+      const auto to = GetRow(y);
+      ::std::copy_n(from.mSymbols.data()  + r.mX, r.mWidth, to.mSymbols.data()  + r.mX);
+      ::std::copy_n(from.mFgColors.data() + r.mX, r.mWidth, to.mFgColors.data() + r.mX);
+      ::std::copy_n(from.mBgColors.data() + r.mX, r.mWidth, to.mBgColors.data() + r.mX);
+      ::std::copy_n(from.mStyle.data()    + r.mX, r.mWidth, to.mStyle.data()    + r.mX);
+   }
+}
+
+/// Copy only the pixels of another image, that have a nonzero mask           
+///   @param other - the image to copy from, must be of the same size         
+///   @param mask - the mask, must be of the same size                        
+void ASCIIImage::CopyMasked(const ASCIIImage& other, const ASCIIBuffer<uint8_t>& mask) {
+   LANGULUS_ASSUME(DevAssumes, GetWidth()  == other.GetWidth()
+                           and GetHeight() == other.GetHeight()
+                           and GetWidth()  == mask.GetWidth()
+                           and GetHeight() == mask.GetHeight(),
+      "Image size mismatch");
+
+   for (int y = 0; y < GetHeight(); ++y) {
+      const auto m = mask.GetRow(y).data();
+      const auto from = other.GetRow(y);
+      const auto to = GetRow(y);
+
+      // Each plane is a branchless select, so that it vectorizes       
+      auto select = [&](auto& t, const auto& f) {
+         for (size_t x = 0; x < t.size(); ++x)
+            t[x] = m[x] ? f[x] : t[x];
+      };
+
+      select(to.mSymbols,  from.mSymbols);
+      select(to.mFgColors, from.mFgColors);
+      select(to.mBgColors, from.mBgColors);
+      select(to.mStyle,    from.mStyle);
+   }
+}
+
+/// Copy only the covered pixels of another image, skipping uncovered rows    
+/// wholesale, and copying solid runs without masking                         
+///   @param other - the image to copy from, must be of the same size         
+///   @param mask - the coverage, must be of the same size                    
+void ASCIIImage::CopyMasked(const ASCIIImage& other, const ASCIICoverage& mask) {
+   LANGULUS_ASSUME(DevAssumes, GetWidth()  == other.GetWidth()
+                           and GetHeight() == other.GetHeight()
+                           and GetWidth()  == mask.GetWidth()
+                           and GetHeight() == mask.GetHeight(),
+      "Image size mismatch");
+   if (mask.IsEmpty())
+      return;
+
+   for (int y = 0; y < GetHeight(); ++y) {
+      const auto& span = mask.GetSpan(y);
+      if (span.IsEmpty())
+         continue;
+
+      const auto from = other.GetRow(y);
+      const auto to = GetRow(y);
+      const auto m = mask.GetMask().GetRow(y).data();
+      auto select = [&](auto& t, const auto& f) {
+         if (span.IsSolid()) {
+            ::std::copy(f.data() + span.mBegin, f.data() + span.mEnd, t.data() + span.mBegin);
+            return;
+         }
+
+         for (int x = span.mBegin; x < span.mEnd; ++x)
+            t[x] = m[x] ? f[x] : t[x];
+      };
+
+      select(to.mSymbols,  from.mSymbols);
+      select(to.mFgColors, from.mFgColors);
+      select(to.mBgColors, from.mBgColors);
+      select(to.mStyle,    from.mStyle);
+   }
+}
+
+/// Copy the covered pixels of another image, and fill all uncovered pixels   
+/// with a uniform symbol and style. Touches every pixel exactly once, so it  
+/// doubles as a clear for the first composited image                         
+///   @param other - the image to copy from, must be of the same size         
+///   @param mask - the coverage, must be of the same size                    
+///   @param s - the symbol for uncovered pixels                              
+///   @param fg - the foreground color for uncovered pixels                   
+///   @param bg - the background color for uncovered pixels                   
+///   @param f - the emphasis for uncovered pixels                            
+void ASCIIImage::CopyMaskedOrFill(
+   const ASCIIImage& other, const ASCIICoverage& mask,
+   ::std::string_view s, RGBAf fg, RGBAf bg, Style f
+) {
+   LANGULUS_ASSUME(DevAssumes, GetWidth()  == other.GetWidth()
+                           and GetHeight() == other.GetHeight()
+                           and GetWidth()  == mask.GetWidth()
+                           and GetHeight() == mask.GetHeight(),
+      "Image size mismatch");
+   if (mask.IsEmpty())
+      return Fill(s, fg, bg, f);
+
+   for (int y = 0; y < GetHeight(); ++y) {
+      const auto& span = mask.GetSpan(y);
+      const auto to = GetRow(y);
+      if (span.IsEmpty()) {
+         // Nothing covered on this row, just clear it                  
+         ::std::fill(to.mSymbols.begin(),  to.mSymbols.end(),  s);
+         ::std::fill(to.mFgColors.begin(), to.mFgColors.end(), fg);
+         ::std::fill(to.mBgColors.begin(), to.mBgColors.end(), bg);
+         ::std::fill(to.mStyle.begin(),    to.mStyle.end(),    f);
+         continue;
+      }
+
+      const auto from = other.GetRow(y);
+      const auto m = mask.GetMask().GetRow(y).data();
+      auto select = [&](auto& t, const auto& src, const auto& clear) {
+         ::std::fill(t.data(), t.data() + span.mBegin, clear);
+         for (int x = span.mBegin; x < span.mEnd; ++x)
+            t[x] = m[x] ? src[x] : clear;
+         ::std::fill(t.data() + span.mEnd, t.data() + t.size(), clear);
+      };
+
+      select(to.mSymbols,  from.mSymbols,  s);
+      select(to.mFgColors, from.mFgColors, fg);
+      select(to.mBgColors, from.mBgColors, bg);
+      select(to.mStyle,    from.mStyle,    f);
+   }
+}
+
+namespace
+{
+   /// Blend a source row over a destination row using the source alpha       
+   /// Symbols and styles are taken from the source only where it is mostly   
+   /// opaque, because symbols can't be blended                               
+   void BlendRow(
+      const ASCIIImage::Row& to, const ASCIIImage::Row& from,
+      const uint8_t* mask, size_t count
+   ) {
+      for (size_t x = 0; x < count; ++x) {
+         if (mask and not mask[x])
+            continue;
+
+         const auto a = from.mBgColors[x].a;
+         to.mBgColors[x] = from.mBgColors[x] * a + to.mBgColors[x] * (1 - a);
+         to.mFgColors[x] = from.mFgColors[x] * a + to.mFgColors[x] * (1 - a);
+         if (a >= 0.5f) {
+            to.mSymbols[x] = from.mSymbols[x];
+            to.mStyle[x] = from.mStyle[x];
+         }
+      }
+   }
+}
+
+/// Blend another image of the same size on top of this one                   
+///   @param other - the image to blend, alpha taken from its background      
+void ASCIIImage::Blend(const ASCIIImage& other) {
+   LANGULUS_ASSUME(DevAssumes, GetWidth()  == other.GetWidth()
+                           and GetHeight() == other.GetHeight(),
+      "Image size mismatch");
+
+   for (int y = 0; y < GetHeight(); ++y)
+      BlendRow(GetRow(y), other.GetRow(y), nullptr, mView.mWidth);
+}
+
+/// Blend another image of the same size on top of this one, only where the   
+/// mask is nonzero                                                           
+///   @param other - the image to blend, alpha taken from its background      
+///   @param mask - the mask, must be of the same size                        
+void ASCIIImage::Blend(const ASCIIImage& other, const ASCIIBuffer<uint8_t>& mask) {
+   LANGULUS_ASSUME(DevAssumes, GetWidth()  == other.GetWidth()
+                           and GetHeight() == other.GetHeight()
+                           and GetWidth()  == mask.GetWidth()
+                           and GetHeight() == mask.GetHeight(),
+      "Image size mismatch");
+
+   for (int y = 0; y < GetHeight(); ++y)
+      BlendRow(GetRow(y), other.GetRow(y), mask.GetRow(y).data(), mView.mWidth);
+}
+
+/// Blend another image of the same size on top of this one, only where it    
+/// is covered, skipping uncovered rows wholesale                             
+///   @param other - the image to blend, alpha taken from its background      
+///   @param mask - the coverage, must be of the same size                    
+void ASCIIImage::Blend(const ASCIIImage& other, const ASCIICoverage& mask) {
+   LANGULUS_ASSUME(DevAssumes, GetWidth()  == other.GetWidth()
+                           and GetHeight() == other.GetHeight()
+                           and GetWidth()  == mask.GetWidth()
+                           and GetHeight() == mask.GetHeight(),
+      "Image size mismatch");
+   if (mask.IsEmpty())
+      return;
+
+   for (int y = 0; y < GetHeight(); ++y) {
+      const auto& span = mask.GetSpan(y);
+      if (span.IsEmpty())
+         continue;
+
+      const auto to = GetRow(y);
+      const auto from = other.GetRow(y);
+      const auto count = static_cast<size_t>(span.mEnd - span.mBegin);
+      BlendRow({
+            to.mSymbols.subspan(span.mBegin, count),
+            to.mFgColors.subspan(span.mBegin, count),
+            to.mBgColors.subspan(span.mBegin, count),
+            to.mStyle.subspan(span.mBegin, count)
+         }, {
+            from.mSymbols.subspan(span.mBegin, count),
+            from.mFgColors.subspan(span.mBegin, count),
+            from.mBgColors.subspan(span.mBegin, count),
+            from.mStyle.subspan(span.mBegin, count)
+         },
+         mask.GetMask().GetRow(y).data() + span.mBegin, count
+      );
+   }
+}
+
+/// Convert the image to a true color buffer, discarding symbols              
+/// Empty symbols take the background color, all others the foreground        
+///   @param out - [out] the buffer to write to                               
+void ASCIIImage::Convert(ASCIIBuffer<RGBAf>& out) const {
+   out.Resize(GetWidth(), GetHeight());
+
+   for (int y = 0; y < GetHeight(); ++y) {
+      const auto row = GetRow(y);
+      const auto to = out.GetRow(y);
+      for (size_t x = 0; x < to.size(); ++x) {
+         to[x] = row.mSymbols[x] == " "
+            ? row.mBgColors[x]
+            : row.mFgColors[x];
       }
    }
 }
@@ -9,6 +9,89 @@
 #include "../Common.hpp"
 #include <Langulus/Image.hpp>
 #include <Langulus/Verbs/Compare.hpp>
+#include <algorithm>
+#include <span>
+#include <vector>
+
+
+///                                                                           
+///   A rectangular region inside a screen buffer, in pixels                  
+///                                                                           
+/// Used to restrict bulk operations to a part of a buffer or image           
+///                                                                           
+struct ASCIIRect {
+   int mX = 0;
+   int mY = 0;
+   int mWidth = 0;
+   int mHeight = 0;
+
+   /// Check if the rectangle contains no pixels                              
+   constexpr bool IsEmpty() const noexcept {
+      return mWidth <= 0 or mHeight <= 0;
+   }
+
+   /// Get the size of the rectangle                                          
+   auto GetScale() const noexcept -> Scale2 {
+      return {static_cast<Real>(mWidth), static_cast<Real>(mHeight)};
+   }
+
+   /// Clip the rectangle to the limits of a buffer                           
+   ///   @param w - buffer width                                              
+   ///   @param h - buffer height                                             
+   ///   @return the clipped rectangle, might be empty                        
+   constexpr auto Clip(int w, int h) const noexcept -> ASCIIRect {
+      const int x0 = ::std::max(mX, 0);
+      const int y0 = ::std::max(mY, 0);
+      const int x1 = ::std::min(mX + mWidth,  w);
+      const int y1 = ::std::min(mY + mHeight, h);
+      return {x0, y0, ::std::max(x1 - x0, 0), ::std::max(y1 - y0, 0)};
+   }
+};
+
+
+///                                                                           
+///   Screen buffer capacity                                                  
+///                                                                           
+///   Buffers keep a capacity larger than their logical size, so that         
+/// resizing within it reuses storage. Capacity grows with some headroom, and 
+/// is released only when the logical area drops well below it, so that       
+/// interactive terminal resizes don't reallocate on every step. Rows are     
+/// always mStride pixels apart, regardless of the logical width.             
+///                                                                           
+struct ASCIICapacity {
+   int mStride = 0;
+   int mRows = 0;
+
+   /// Check if a logical size can reuse this capacity                        
+   ///   @param x - logical width                                             
+   ///   @param y - logical height                                            
+   ///   @return true if size fits, and doesn't waste too much of it          
+   constexpr bool Fits(int x, int y) const noexcept {
+      return x <= mStride and y <= mRows
+         and x * y * 4 >= mStride * mRows;
+   }
+
+   /// Make a capacity with some headroom for a logical size                  
+   ///   @param x - logical width                                             
+   ///   @param y - logical height                                            
+   ///   @return the capacity                                                 
+   static constexpr auto For(int x, int y) noexcept -> ASCIICapacity {
+      return {x + x / 4, y + y / 4};
+   }
+
+   /// Number of pixels to allocate                                           
+   constexpr int GetCount() const noexcept {
+      return mStride * mRows;
+   }
+
+   /// Number of pixels from the start of the first row, to the end of the    
+   /// last row, including the padding between rows                           
+   ///   @param x - logical width                                             
+   ///   @param y - number of rows                                            
+   constexpr int GetSpan(int x, int y) const noexcept {
+      return y ? mStride * (y - 1) + x : 0;
+   }
+};
 
 
 ///                                                                           
@@ -20,12 +103,17 @@
 ///   This intermediate image is required, because depending on the pipeline's
 /// style, a different set of symbols are used, each requiring a different    
 /// resolution and pixel->symbol mapping.                                     
+///   Pixels are stored row by row, so each row is a contiguous span, and all 
+/// bulk operations work on whole rows instead of individual pixels. Rows are 
+/// GetStride() pixels apart, which might be more than the width.             
 ///                                                                           
 template<class T>
 struct ASCIIBuffer final : A::Image {
 private:
    // Data for the buffer                                               
    mutable TMany<T> mData;
+   // Allocated size, retained between resizes                          
+   ASCIICapacity mCapacity;
 
 public:
    LANGULUS(ABSTRACT) false;
@@ -33,17 +121,53 @@ public:
 
    ASCIIBuffer() : Resolvable {this} {}
 
+   /// Resize the buffer, reusing storage if the new size fits in capacity    
+   /// Pixels inside both the old and new size are preserved, and the newly   
+   /// exposed area is cleared                                                
+   ///   @param x - new width                                                 
+   ///   @param y - new height                                                
    void Resize(int x, int y) {
       LANGULUS_ASSUME(DevAssumes, x and y, "Invalid resize dimensions");
-      if (x == static_cast<int>(mView.mWidth)
-      and y == static_cast<int>(mView.mHeight))
+      const int oldx = GetWidth();
+      const int oldy = GetHeight();
+      if (x == oldx and y == oldy)
          return;
 
-      const auto count = x * y;
-      mData.Clear();
-      mData.New(count);
       mView.mWidth = static_cast<uint32_t>(x);
       mView.mHeight = static_cast<uint32_t>(y);
+
+      if (mCapacity.Fits(x, y)) {
+         Fill({oldx, 0, x - oldx, ::std::min(oldy, y)}, T {});
+         Fill({0, oldy, x, y - oldy}, T {});
+         return;
+      }
+
+      mCapacity = ASCIICapacity::For(x, y);
+      mData.Clear();
+      mData.New(mCapacity.GetCount());
+   }
+
+   int GetWidth() const noexcept {
+      return static_cast<int>(mView.mWidth);
+   }
+
+   int GetHeight() const noexcept {
+      return static_cast<int>(mView.mHeight);
+   }
+
+   /// Get the distance between rows, in pixels                               
+   int GetStride() const noexcept {
+      return mCapacity.mStride;
+   }
+
+   /// Get the allocated size, including the retained capacity                
+   size_t GetBytes() const noexcept {
+      return static_cast<size_t>(mCapacity.GetCount()) * sizeof(T);
+   }
+
+   /// Get the full rectangle of the buffer                                   
+   auto GetRect() const noexcept -> ASCIIRect {
+      return {0, 0, GetWidth(), GetHeight()};
    }
 
    T& Get(int x, int y) {
@@ -53,11 +177,129 @@ public:
       LANGULUS_ASSUME(DevAssumes,
          y < static_cast<int>(mView.mHeight) and y >= 0,
          "Pixel out of vertical limits");
-      return mData[y * static_cast<int>(mView.mWidth) + x];
+      return mData[y * mCapacity.mStride + x];
+   }
+
+   /// Get a contiguous row of pixels, without any per-pixel checks           
+   ///   @param y - the row index                                             
+   ///   @return the span of pixels in the row                                
+   auto GetRow(int y) const -> ::std::span<T> {
+      LANGULUS_ASSUME(DevAssumes,
+         y < static_cast<int>(mView.mHeight) and y >= 0,
+         "Row out of vertical limits");
+      return {mData.GetRaw() + y * mCapacity.mStride, mView.mWidth};
    }
 
    void Fill(const T& v) {
-      mData.Fill(v);
+      Fill(GetRect(), v);
+   }
+
+   /// Fill a rectangle with a value                                          
+   ///   @param rect - the rectangle to fill, clipped to the buffer           
+   ///   @param v - the value to fill with                                    
+   void Fill(const ASCIIRect& rect, const T& v) {
+      const auto r = rect.Clip(GetWidth(), GetHeight());
+      if (r.IsEmpty())
+         return;
+
+      if (r.mX == 0 and r.mWidth == GetWidth()) {
+         // Fill full rows as a single block, along with the padding    
+         // between them                                                
+         ::std::fill_n(GetRow(r.mY).data(), mCapacity.GetSpan(r.mWidth, r.mHeight), v);
+         return;
+      }
+
+      for (int y = r.mY; y < r.mY + r.mHeight; ++y)
+         ::std::fill_n(GetRow(y).data() + r.mX, r.mWidth, v);
+   }
+
+   /// Copy another buffer of the same size                                   
+   ///   @param other - the buffer to copy                                    
+   void Copy(const ASCIIBuffer& other) {
+      LANGULUS_ASSUME(DevAssumes, GetWidth()  == other.GetWidth()
+                              and GetHeight() == other.GetHeight(),
+         "Buffer size mismatch");
+      if (GetStride() != other.GetStride())
+         return Copy(other, GetRect());
+
+      ::std::copy_n(other.mData.GetRaw(),
+         mCapacity.GetSpan(GetWidth(), GetHeight()), mData.GetRaw());
+   }
+
+   /// Copy a rectangle from another buffer, at the same coordinates          
+   ///   @param other - the buffer to copy from                               
+   ///   @param rect - the rectangle to copy, clipped to both buffers         
+   void Copy(const ASCIIBuffer& other, const ASCIIRect& rect) {
+      const auto r = rect
+         .Clip(GetWidth(), GetHeight())
+         .Clip(other.GetWidth(), other.GetHeight());
+      for (int y = r.mY; y < r.mY + r.mHeight; ++y) {
+         ::std::copy_n(other.GetRow(y).data() + r.mX, r.mWidth,
+                       GetRow(y).data() + r.mX);
+      }
+   }
+
+   /// Copy only the pixels of another buffer, that have a nonzero mask       
+   ///   @param other - the buffer to copy from, must be of the same size     
+   ///   @param mask - the mask, must be of the same size                     
+   void CopyMasked(const ASCIIBuffer& other, const ASCIIBuffer<uint8_t>& mask) {
+      LANGULUS_ASSUME(DevAssumes, GetWidth()  == other.GetWidth()
+                              and GetHeight() == other.GetHeight()
+                              and GetWidth()  == mask.GetWidth()
+                              and GetHeight() == mask.GetHeight(),
+         "Buffer size mismatch");
+
+      for (int y = 0; y < GetHeight(); ++y) {
+         const auto m = mask.GetRow(y).data();
+         const auto src = other.GetRow(y).data();
+         auto dst = GetRow(y).data();
+
+         // Written as a branchless select, so that it vectorizes       
+         for (int x = 0; x < GetWidth(); ++x)
+            dst[x] = m[x] ? src[x] : dst[x];
+      }
+   }
+
+   /// Check if all pixels match another buffer of the same size              
+   ///   @param other - the buffer to compare against                         
+   ///   @return true if sizes and all pixels match                           
+   bool Matches(const ASCIIBuffer& other) const {
+      if (GetWidth() != other.GetWidth() or GetHeight() != other.GetHeight())
+         return false;
+
+      for (int y = 0; y < GetHeight(); ++y) {
+         const auto row = GetRow(y);
+         if (not ::std::equal(row.begin(), row.end(), other.GetRow(y).begin()))
+            return false;
+      }
+
+      return true;
+   }
+
+   /// Check if all pixels are equal to a single value                        
+   ///   @param v - the value to compare against                              
+   ///   @return true if all pixels match                                     
+   bool Matches(const T& v) const {
+      for (int y = 0; y < GetHeight(); ++y) {
+         const auto row = GetRow(y);
+         if (not ::std::all_of(row.begin(), row.end(),
+            [&v](const T& p) noexcept { return p == v; }))
+            return false;
+      }
+
+      return true;
+   }
+
+   /// Convert all pixels into another buffer of the same size                
+   ///   @param out - [out] the buffer to write to                            
+   ///   @param convert - the conversion function T -> U                      
+   template<class U>
+   void Convert(ASCIIBuffer<U>& out, auto&& convert) const {
+      out.Resize(GetWidth(), GetHeight());
+      for (int y = 0; y < GetHeight(); ++y) {
+         const auto row = GetRow(y);
+         ::std::transform(row.begin(), row.end(), out.GetRow(y).begin(), convert);
+      }
    }
 
    auto ForEachPixel(auto&& call) const {
@@ -68,14 +310,14 @@ public:
          "Pixel iterator must be CT::Similar to T");
 
       [[maybe_unused]] Count counter = 0;
-      for (uint32_t y = 0; y < mView.mHeight; ++y) {
-         for (uint32_t x = 0; x < mView.mWidth; ++x) {
+      for (int y = 0; y < GetHeight(); ++y) {
+         for (auto& pixel : GetRow(y)) {
             if constexpr (CT::Bool<R>) {
-               if (not call(Get(x, y)))
+               if (not call(pixel))
                   return counter;
                ++counter;
             }
-            else call(Get(x, y));
+            else call(pixel);
          }
       }
 
@@ -85,12 +327,133 @@ public:
 
    void Reset() {
       mData.Reset();
+      mCapacity = {};
       mView = {};
       mDataListMap.Reset();
    }
 };
 
 
+///                                                                           
+///   A coverage mask                                                         
+///                                                                           
+///   Marks which pixels of a screen buffer were written, along with the      
+/// covered span and pixel count of each row. It is produced as a byproduct   
+/// of rendering, and allows compositing to skip empty rows wholesale, and to 
+/// copy solid runs without any masking.                                      
+///                                                                           
+struct ASCIICoverage {
+   /// Covered horizontal span of a single row, as [mBegin, mEnd)             
+   struct Span {
+      int mBegin = 0;
+      int mEnd = 0;
+      int mCount = 0;
+
+      bool IsEmpty() const noexcept { return mCount == 0; }
+      bool IsSolid() const noexcept { return mCount == mEnd - mBegin; }
+   };
+
+private:
+   // One byte per pixel, nonzero if covered                            
+   ASCIIBuffer<uint8_t> mMask;
+   // One span per row                                                  
+   ::std::vector<Span> mSpans;
+   // Number of rows that have any coverage                             
+   int mCoveredRows = 0;
+   // Number of covered pixels in all rows                              
+   size_t mCoveredPixels = 0;
+
+public:
+   void Resize(int x, int y) {
+      if (x == mMask.GetWidth() and y == mMask.GetHeight())
+         return;
+
+      // Clearing first leaves the retained area zeroed, and the mask   
+      // zeroes the newly exposed area by itself                        
+      Clear();
+      mMask.Resize(x, y);
+      mSpans.assign(static_cast<size_t>(y), {});
+   }
+
+   /// Clear the coverage, touching only the spans that were marked           
+   void Clear() {
+      if (not mCoveredRows)
+         return;
+
+      for (int y = 0; y < mMask.GetHeight(); ++y) {
+         auto& span = mSpans[y];
+         if (span.IsEmpty())
+            continue;
+
+         ::std::fill_n(mMask.GetRow(y).data() + span.mBegin, span.mEnd - span.mBegin, 0);
+         span = {};
+      }
+
+      mCoveredRows = 0;
+      mCoveredPixels = 0;
+   }
+
+   /// Mark a single pixel as covered                                         
+   ///   @param x - the pixel column                                          
+   ///   @param y - the pixel row                                             
+   void Mark(int x, int y) {
+      auto& m = mMask.GetRow(y)[x];
+      if (m)
+         return;
+
+      m = 1;
+      ++mCoveredPixels;
+      auto& span = mSpans[y];
+      if (span.IsEmpty()) {
+         span = {x, x + 1, 1};
+         ++mCoveredRows;
+         return;
+      }
+
+      span.mBegin = ::std::min(span.mBegin, x);
+      span.mEnd = ::std::max(span.mEnd, x + 1);
+      ++span.mCount;
+   }
+
+   bool IsEmpty() const noexcept {
+      return mCoveredRows == 0;
+   }
+
+   /// Get the number of covered pixels                                       
+   size_t GetCount() const noexcept {
+      return mCoveredPixels;
+   }
+
+   auto GetSpan(int y) const -> const Span& {
+      return mSpans[y];
+   }
+
+   auto GetMask() const noexcept -> const ASCIIBuffer<uint8_t>& {
+      return mMask;
+   }
+
+   int GetWidth() const noexcept {
+      return mMask.GetWidth();
+   }
+
+   int GetHeight() const noexcept {
+      return mMask.GetHeight();
+   }
+
+   /// Get the allocated size of the mask and spans                           
+   size_t GetBytes() const noexcept {
+      return mMask.GetBytes() + mSpans.capacity() * sizeof(Span);
+   }
+
+   void Reset() {
+      mMask.Reset();
+      mSpans.clear();
+      mCoveredRows = 0;
+      mCoveredPixels = 0;
+   }
+};
+
+
 ///                                                                           
 ///   An ASCII image                                                          
 ///                                                                           
@@ -106,6 +469,9 @@ private:
    mutable TMany<RGBAf> mFgColors;  // Array of background colors       
    mutable TMany<Style> mStyle;     // Array of styles for each pixel   
 
+   // Allocated size of all planes, retained between resizes            
+   ASCIICapacity mCapacity;
+
    // Required only in case we're comparing against other images,       
    // provided by a filename                                            
    ASCIIRenderer* mRenderer;
@@ -130,11 +496,37 @@ public:
       bool operator == (const RGBAf&) const noexcept;
    };
 
+   /// A contiguous row of pixels from the image, one span per plane          
+   struct Row {
+      ::std::span<Token> mSymbols;
+      ::std::span<RGBAf> mFgColors;
+      ::std::span<RGBAf> mBgColors;
+      ::std::span<Style> mStyle;
+   };
+
    void Resize(int x, int y);
+   auto GetWidth() const noexcept -> int;
+   auto GetHeight() const noexcept -> int;
+   auto GetStride() const noexcept -> int;
+   auto GetRect() const noexcept -> ASCIIRect;
+   auto GetBytes() const noexcept -> size_t;
    auto GetPixel(int x, int y) const -> Pixel;
+   auto GetRow(int y) const -> Row;
+
    void Fill(Token, RGBAf fg = Colors::White, RGBAf bg = Colors::Black, Style = {});
+   void Fill(const ASCIIRect&, Token, RGBAf fg = Colors::White, RGBAf bg = Colors::Black, Style = {});
    void Compare(Verb&) const;
    void Copy(const ASCIIImage&);
+   void Copy(const ASCIIImage&, const ASCIIRect&);
+   void CopyMasked(const ASCIIImage&, const ASCIIBuffer<uint8_t>&);
+   void CopyMasked(const ASCIIImage&, const ASCIICoverage&);
+   void CopyMaskedOrFill(const ASCIIImage&, const ASCIICoverage&, Token, RGBAf fg = Colors::White, RGBAf bg = Colors::Black, Style = {});
+   void Blend(const ASCIIImage&);
+   void Blend(const ASCIIImage&, const ASCIIBuffer<uint8_t>&);
+   void Blend(const ASCIIImage&, const ASCIICoverage&);
+   bool Matches(const ASCIIImage&) const;
+   bool MatchesColor(const RGBAf&) const;
+   void Convert(ASCIIBuffer<RGBAf>&) const;
    auto ForEachPixel(auto&&) const;
    void Reset();
 };
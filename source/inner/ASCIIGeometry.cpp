@@ -8,75 +8,391 @@
 #include "../ASCII.hpp"
 #include <Langulus/Math/Normal.hpp>
 #include <Langulus/Math/Sampler.hpp>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
 
 
 /// Descriptor constructor                                                    
+/// Conversion of the mesh is submitted as a background job, and the          
+/// geometry can't be used until Poll() reports it's done                     
 ///   @param producer - the producer of the unit                              
 ///   @param descriptor - the unit descriptor                                 
 ASCIIGeometry::ASCIIGeometry(ASCIIRenderer* producer, const Many& descriptor)
    : Resolvable   {this}
    , ProducedFrom {producer, descriptor} {
-   bool firstVertex = true;
-   Range4 dataRange;
-
-   // Scan the descriptor                                               
    descriptor.ForEachDeep([&](const A::Mesh& mesh) {
-      if (mesh.MadeOfTriangles()) {
-         // Cache a triangle list                                       
-         mesh.ForEachVertex(
-            [&](const Traits::Place&   p,
-                const Traits::Aim&     n,
-                const Traits::Sampler& t,
-                const Traits::Color&   c
-            ) {
-               Vertex output;
-               LANGULUS_ASSERT(p, Access, "No vertex position");
-
-               if (p.IsSimilar<Vec3>())
-                  output.mPos = Vec4(*p.GetRaw<Vec3>(), 1);
-               else if (p.IsSimilar<Vec2>())
-                  output.mPos = Vec4(*p.GetRaw<Vec2>(), 0, 1);
-               else if (p.IsSimilar<Vec4>())
-                  output.mPos = *p.GetRaw<Vec4>();
-               else
-                  LANGULUS_OOPS(Access, "Unsupported place type");
-
-               if (firstVertex) {
-                  dataRange.mMin = dataRange.mMax = output.mPos;
-                  firstVertex = false;
-               }
-               else dataRange.Embrace(output.mPos);
-
-               if (n) {
-                  if (n.IsSimilar<Vec3>())
-                     output.mNor = *n.GetRaw<Vec3>();
-                  else
-                     LANGULUS_OOPS(Access, "Unsupported normal type");
-               }
-
-               if (t) {
-                  if (t and t.IsSimilar<Vec2>())
-                     output.mTex = *t.GetRaw<Vec2>();
-                  else
-                     LANGULUS_OOPS(Access, "Unsupported sampler type");
-               }
-
-               if (c)
-                  output.mCol = c.AsCast<RGBA, false>();
-
-               // Cache the vertex                                      
-               mVertices << output;
-            }
-         );
-
-         mView.mTopology = MetaDataOf<A::Triangle>();
-         mView.mPrimitiveCount = static_cast<uint32_t>(mVertices.GetCount() / 3);
-         mView.mTextureMapping = Math::MapMode::Custom;
-      }
-      else TODO();
+      if (not mContent)
+         mContent = &mesh;
+   });
+
+   // Without content there's nothing to convert, nor to evict          
+   mResident = not mContent;
+   Request();
+}
+
+/// Submit a background conversion, unless the content is already in memory,  
+/// or is being converted. The vertex attributes are copied from the mesh     
+/// here, so that the background job works only on plain data                 
+void ASCIIGeometry::Request() {
+   if (mResident or mConversion)
+      return;
+
+   auto conversion = ::std::make_shared<Conversion>();
+   try { Gather(*mContent, *conversion); }
+   catch (...) {
+      // Failed conversions still count as resident, so that they       
+      // aren't attempted again on each frame                           
+      mResident = true;
+      throw;
+   }
+
+   // Converted meshes are cached on disk, keyed by the content hash    
+   auto module = GetProducer()->GetProducer();
+   conversion->mKey = mContent->GetHash().mHash;
+   conversion->mCache = &module->GetGeometryCache();
+   mConversion = ::std::move(conversion);
+   module->GetWorkers().Submit([conversion = mConversion] {
+      int expected = Conversion::Queued;
+      if (not conversion->mState.compare_exchange_strong(expected, Conversion::Running))
+         return;
+
+      try { Convert(*conversion); }
+      catch (...) { conversion->mException = ::std::current_exception(); }
+      conversion->mState.store(Conversion::Done, ::std::memory_order_release);
    });
+}
+
+/// Cancel the conversion if it hasn't started yet. A running conversion is   
+/// left to finish on its own - it touches only its shared state, and the     
+/// module's geometry cache, which outlives all background jobs               
+ASCIIGeometry::~ASCIIGeometry() {
+   if (not mConversion)
+      return;
+
+   int expected = Conversion::Queued;
+   mConversion->mState.compare_exchange_strong(expected, Conversion::Cancelled);
+}
+
+/// Load the converted mesh from the cache, or convert the mesh to the        
+/// interleaved vertex format, simplify it, and store it in the cache         
+/// Executed in the background, so it must not touch the allocator - all      
+/// results are kept in standard containers until adopted                     
+///   @param conversion - the conversion to perform                           
+void ASCIIGeometry::Convert(Conversion& conversion) {
+   auto& cache = *conversion.mCache;
+   const bool cached = cache.Load(conversion.mKey, sizeof(Vertex), conversion.mCached);
+   if (cached)
+      conversion.mRange = conversion.mCached.mRange;
+   else {
+      conversion.mCached = {};
+      Import(conversion);
+   }
+
+   conversion.mView.mTopology = MetaDataOf<A::Triangle>();
+   conversion.mView.mPrimitiveCount = static_cast<uint32_t>((cached
+      ? conversion.mCached.mLevels.front().mCount
+      : conversion.mLevels.front().mVertices.size()) / 3);
+   conversion.mView.mTextureMapping = Math::MapMode::Custom;
+
+   const auto& range = conversion.mRange;
+   conversion.mBounds = {
+      Vec3 {range.mMin.x, range.mMin.y, range.mMin.z},
+      Vec3 {range.mMax.x, range.mMax.y, range.mMax.z}
+   };
+
+   if (cached)
+      return;
+
+   Simplify(conversion.mLevels, conversion.mBounds);
+
+   ::std::vector<ASCIIGeometryCache::Level> levels;
+   for (const auto& level : conversion.mLevels)
+      levels.push_back({level.mVertices.data(), level.mVertices.size(), level.mError});
+   cache.Store(conversion.mKey, sizeof(Vertex), conversion.mRange, levels);
+}
 
-   Logger::Verbose(Self(), "Range is: ", dataRange);
+/// Copy the vertex attributes of a mesh into plain arrays                    
+/// Must be called on the thread that owns the geometry                       
+///   @param mesh - the mesh to copy from                                     
+///   @param conversion - [out] the conversion to copy to                     
+void ASCIIGeometry::Gather(const A::Mesh& mesh, Conversion& conversion) {
+   if (not mesh.MadeOfTriangles())
+      TODO();
+
+   mesh.ForEachVertex(
+      [&](const Traits::Place&   p,
+          const Traits::Aim&     n,
+          const Traits::Sampler& t,
+          const Traits::Color&   c
+      ) {
+         // Missing attributes take the defaults of the vertex format   
+         Vertex output;
+         LANGULUS_ASSERT(p, Access, "No vertex position");
+
+         if (p.IsSimilar<Vec3>())
+            output.mPos = Vec4(*p.GetRaw<Vec3>(), 1);
+         else if (p.IsSimilar<Vec2>())
+            output.mPos = Vec4(*p.GetRaw<Vec2>(), 0, 1);
+         else if (p.IsSimilar<Vec4>())
+            output.mPos = *p.GetRaw<Vec4>();
+         else
+            LANGULUS_OOPS(Access, "Unsupported place type");
+
+         if (n) {
+            if (n.IsSimilar<Vec3>())
+               output.mNor = *n.GetRaw<Vec3>();
+            else
+               LANGULUS_OOPS(Access, "Unsupported normal type");
+         }
+
+         if (t) {
+            if (t.IsSimilar<Vec2>())
+               output.mTex = *t.GetRaw<Vec2>();
+            else
+               LANGULUS_OOPS(Access, "Unsupported sampler type");
+         }
+
+         if (c)
+            output.mCol = c.AsCast<RGBA, false>();
+
+         conversion.mPositions.push_back(output.mPos);
+         conversion.mNormals.push_back(output.mNor);
+         conversion.mTexCoords.push_back(output.mTex);
+         conversion.mColors.push_back(output.mCol);
+      }
+   );
+}
+
+/// Interleave the gathered vertex attributes into a triangle list, and find  
+/// their range. The attributes are released afterwards                       
+///   @param conversion - the conversion to perform                           
+void ASCIIGeometry::Import(Conversion& conversion) {
+   const auto count = conversion.mPositions.size();
+   auto& vertices = conversion.mLevels.emplace_back().mVertices;
+   vertices.resize(count);
+
+   for (size_t i = 0; i < count; ++i) {
+      auto& v = vertices[i];
+      v.mPos = conversion.mPositions[i];
+      v.mNor = conversion.mNormals[i];
+      v.mTex = conversion.mTexCoords[i];
+      v.mCol = conversion.mColors[i];
+
+      if (i == 0)
+         conversion.mRange.mMin = conversion.mRange.mMax = v.mPos;
+      else
+         conversion.mRange.Embrace(v.mPos);
+   }
+
+   conversion.mPositions = {};
+   conversion.mNormals = {};
+   conversion.mTexCoords = {};
+   conversion.mColors = {};
+}
+
+/// Check if the converted content is in memory                               
+/// Safe to call from any thread, as long as Poll() isn't running             
+///   @return true if the geometry can be used                                
+bool ASCIIGeometry::IsReady() const noexcept {
+   return mResident;
+}
+
+/// Check on the background conversion, and adopt its results if it's done    
+/// Must be called on the thread that owns the geometry                       
+///   @return true if the geometry can be used                                
+bool ASCIIGeometry::Poll() {
+   if (mResident)
+      return true;
+   if (not mConversion
+   or mConversion->mState.load(::std::memory_order_acquire) != Conversion::Done)
+      return false;
+
+   // Failed conversions still count as resident, so that they aren't   
+   // attempted again on each frame                                     
+   const auto conversion = ::std::move(mConversion);
+   mResident = true;
+   if (conversion->mException)
+      ::std::rethrow_exception(conversion->mException);
+
+   static ::std::atomic<uint64_t> versions = 0;
+   mVersion = ++versions;
+   mView = conversion->mView;
+   mBounds = conversion->mBounds;
+   Logger::Verbose(Self(), "Range is: ", conversion->mRange);
+
+   // Adopt either the levels mapped from the cache, or converted ones  
+   // Each level is allocated once, and copied as a single block        
+   const auto levelCount = conversion->mCached.mLevels.size()
+                         + conversion->mLevels.size();
+   mSimplified.reserve(levelCount ? levelCount - 1 : 0);
+
+   size_t index = 0;
+   auto adopt = [&](const Vertex* vertices, size_t count, Real error) {
+      auto& target = index++
+         ? mSimplified.emplace_back(Simplified {{}, error}).mVertices
+         : mVertices;
+      target.New(count);
+      ::std::copy_n(vertices, count, target.GetRaw());
+      mBytes += count * sizeof(Vertex);
+   };
+
+   for (const auto& level : conversion->mCached.mLevels)
+      adopt(static_cast<const Vertex*>(level.mVertices), level.mCount, level.mError);
+   for (const auto& level : conversion->mLevels)
+      adopt(level.mVertices.data(), level.mVertices.size(), level.mError);
+
+   VERBOSE_ASCII("Generated ", mSimplified.size(), " simplified levels");
+   return true;
+}
+
+/// Release the converted content. The geometry can't be used until it's      
+/// requested, and converted again                                            
+void ASCIIGeometry::Evict() {
+   if (not mResident or not mContent)
+      return;
+
+   mVertices.Reset();
+   mSimplified.clear();
+   mView = {};
+   mBytes = 0;
+   mVersion = 0;
+   mResident = false;
+}
+
+/// Mark the geometry as used                                                 
+///   @param frame - the current renderer frame                               
+void ASCIIGeometry::Touch(uint64_t frame) noexcept {
+   mLastUsed = frame;
+}
+
+/// Get the renderer frame, in which the geometry was last used               
+///   @return the frame                                                       
+auto ASCIIGeometry::GetLastUsed() const noexcept -> uint64_t {
+   return mLastUsed;
+}
+
+/// Get the size of the converted content                                     
+///   @return the size in bytes, zero if not resident                         
+auto ASCIIGeometry::GetBytes() const noexcept -> size_t {
+   return mBytes;
+}
+
+/// Get the version of the converted content                                  
+///   @return the version, unique for each time the content was converted,    
+///      or zero if not resident                                              
+auto ASCIIGeometry::GetVersion() const noexcept -> uint64_t {
+   return mVersion;
+}
+
+namespace
+{
+   using Vertex = ASCIIGeometry::Vertex;
+
+   /// Simplify a triangle list by clustering its vertices in a uniform grid  
+   /// Each cluster is replaced by the average of its vertices, and the       
+   /// triangles that collapse are dropped                                    
+   ///   @param source - the triangle list to simplify                        
+   ///   @param origin - the corner of the grid                               
+   ///   @param cell - the size of a grid cell                                
+   ///   @param error - [out] the largest distance a vertex was moved         
+   ///   @return the simplified triangle list                                 
+   ::std::vector<Vertex> Cluster(
+      const ::std::vector<Vertex>& source, const Vec3& origin, Real cell, Real& error
+   ) {
+      struct Accumulator {
+         Vec4 mPos {};
+         Vec3 mNor {};
+         Vec2 mTex {};
+         RGBA mCol;
+         Real mCount = 0;
+      };
+
+      ::std::unordered_map<uint64_t, uint32_t> clusters;
+      ::std::vector<Accumulator> accumulated;
+      ::std::vector<uint32_t> remap(source.size());
+
+      for (size_t i = 0; i < source.size(); ++i) {
+         const auto& v = source[i];
+         const auto cx = static_cast<uint64_t>((v.mPos.x - origin.x) / cell);
+         const auto cy = static_cast<uint64_t>((v.mPos.y - origin.y) / cell);
+         const auto cz = static_cast<uint64_t>((v.mPos.z - origin.z) / cell);
+         const auto key = (cx & 0x1FFFFF) | (cy & 0x1FFFFF) << 21 | (cz & 0x1FFFFF) << 42;
+
+         auto [it, created] = clusters.try_emplace(
+            key, static_cast<uint32_t>(accumulated.size()));
+         if (created) {
+            accumulated.emplace_back();
+            accumulated.back().mCol = v.mCol;
+         }
+
+         auto& a = accumulated[it->second];
+         a.mPos += v.mPos;
+         a.mNor += v.mNor;
+         a.mTex += v.mTex;
+         a.mCount += 1;
+         remap[i] = it->second;
+      }
+
+      // Average the clusters                                           
+      ::std::vector<Vertex> representatives(accumulated.size());
+      for (size_t i = 0; i < accumulated.size(); ++i) {
+         const auto& a = accumulated[i];
+         auto& r = representatives[i];
+         r.mPos = a.mPos / a.mCount;
+         r.mTex = a.mTex / a.mCount;
+         r.mCol = a.mCol;
+         if (a.mNor.Length() > 0)
+            r.mNor = a.mNor.Normalize();
+      }
+
+      error = 0;
+      for (size_t i = 0; i < source.size(); ++i) {
+         const Vec4 d = source[i].mPos - representatives[remap[i]].mPos;
+         error = ::std::max(error, ::std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z));
+      }
+
+      // Keep only the triangles that didn't collapse                   
+      ::std::vector<Vertex> result;
+      for (size_t i = 0; i + 2 < source.size(); i += 3) {
+         const auto a = remap[i], b = remap[i + 1], c = remap[i + 2];
+         if (a == b or b == c or a == c)
+            continue;
+
+         result.push_back(representatives[a]);
+         result.push_back(representatives[b]);
+         result.push_back(representatives[c]);
+      }
+      return result;
+   }
+}
+
+/// Generate a chain of progressively simplified vertex buffers by vertex     
+/// clustering. The grid starts fine and doubles in size, and a level is kept 
+/// only if it removes at least a quarter of the previous level's triangles   
+///   @param levels - [in/out] the original triangle list, followed by the    
+///      simplified ones after the call                                       
+///   @param bounds - the bounds of the original triangle list                
+void ASCIIGeometry::Simplify(::std::vector<Level>& levels, const ASCIIBounds& bounds) {
+   const Vec3 extent = bounds.mMax - bounds.mMin;
+   const Real largest = ::std::max({extent.x, extent.y, extent.z});
+   if (largest <= 0)
+      return;
+
+   auto previous = levels.front().mVertices.size();
+   for (Real cell = largest / 128; cell < largest
+   and levels.size() <= MaxSimplified; cell *= 2) {
+      Level level;
+      level.mVertices = Cluster(
+         levels.front().mVertices, bounds.mMin, cell, level.mError);
+      if (level.mVertices.empty())
+         break;
+      if (level.mVertices.size() * 4 > previous * 3)
+         continue;
+
+      previous = level.mVertices.size();
+      levels.emplace_back(::std::move(level));
+   }
 }
 
 /// Check if the cached geometry is made of triangles                         
@@ -86,7 +402,32 @@ auto ASCIIGeometry::MadeOfTriangles() const noexcept -> bool {
 }
 
 /// Get the vertex array                                                      
+///   @param lod - the level of simplification, zero for the original         
 ///   @return a reference to the vertex array                                 
-auto ASCIIGeometry::GetVertices() const noexcept -> const TMany<Vertex>& {
-   return mVertices;
+auto ASCIIGeometry::GetVertices(size_t lod) const noexcept -> const TMany<Vertex>& {
+   if (not lod)
+      return mVertices;
+
+   LANGULUS_ASSUME(DevAssumes, lod <= mSimplified.size(), "LOD out of range");
+   return mSimplified[lod - 1].mVertices;
+}
+
+/// Get the number of available levels of simplification                      
+///   @return the number of levels, including the original                    
+auto ASCIIGeometry::GetLODCount() const noexcept -> size_t {
+   return mSimplified.size() + 1;
+}
+
+/// Pick the coarsest level of simplification, whose error remains smaller    
+/// than a single pixel                                                       
+///   @param pixelsPerUnit - how many pixels a model space unit covers        
+///   @return the level of simplification, zero for the original              
+auto ASCIIGeometry::SelectLOD(Real pixelsPerUnit) const noexcept -> size_t {
+   return SelectLOD(mSimplified, pixelsPerUnit);
+}
+
+/// Get the bounds of all vertices                                            
+///   @return the model space bounds                                          
+auto ASCIIGeometry::GetBounds() const noexcept -> const ASCIIBounds& {
+   return mBounds;
 }
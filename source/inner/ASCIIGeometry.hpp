@@ -7,6 +7,12 @@
 ///                                                                           
 #pragma once
 #include "../Common.hpp"
+#include "ASCIIBVH.hpp"
+#include "ASCIIGeometryCache.hpp"
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <vector>
 #include <Langulus/Math/Normal.hpp>
 #include <Langulus/Mesh.hpp>
 
@@ -31,6 +37,14 @@ struct ASCIIGeometry : A::Graphics, ProducedFrom<ASCIIRenderer> {
       RGBA mCol = Colors::White;    // Vertex color                     
    };
 
+   // A triangle list, at some level of simplification. Used while      
+   // converting, before the vertices are adopted                       
+   struct Level {
+      ::std::vector<Vertex> mVertices;
+      // The largest distance a vertex was moved, in model space        
+      Real mError = 0;
+   };
+
 private:
    // Mesh info                                                         
    MeshView mView;
@@ -38,9 +52,104 @@ private:
    // The vertex buffer                                                 
    TMany<Vertex> mVertices;
 
+   // Bounds of all vertices, in model space                            
+   ASCIIBounds mBounds;
+
+   // A simplified version of the vertex buffer                         
+   struct Simplified {
+      TMany<Vertex> mVertices;
+      // The largest distance a vertex was moved, in model space        
+      Real mError;
+   };
+
+   // Progressively coarser versions of the vertex buffer, generated    
+   // at import, each with at most 3/4 of the previous one's triangles  
+   ::std::vector<Simplified> mSimplified;
+   static constexpr size_t MaxSimplified = 6;
+
+   // A conversion running in the background. It's shared with the job, 
+   // so that the geometry can be discarded at any time. The job never  
+   // touches the mesh, only the plain data that was copied from it     
+   struct Conversion {
+      enum State : int {
+         Queued, Running, Done, Cancelled
+      };
+
+      ::std::atomic<int> mState = Queued;
+      // Hash of the mesh, used as the key in the cache                 
+      uint64_t mKey = 0;
+      const ASCIIGeometryCache* mCache = nullptr;
+
+      // Vertex attributes of the mesh, one of each per vertex, copied  
+      // on the thread that owns the geometry                           
+      ::std::vector<Vec4> mPositions;
+      ::std::vector<Vec3> mNormals;
+      ::std::vector<Vec2> mTexCoords;
+      ::std::vector<RGBA> mColors;
+
+      // Results, adopted by Poll() once the state is Done              
+      MeshView mView;
+      Range4 mRange;
+      ASCIIBounds mBounds;
+      // The original vertices, followed by the simplified ones         
+      ::std::vector<Level> mLevels;
+      // Or all of the levels, mapped from the cache                    
+      ASCIIGeometryCache::Entry mCached;
+      // Errors are rethrown when adopting the results                  
+      ::std::exception_ptr mException;
+   };
+
+   ::std::shared_ptr<Conversion> mConversion;
+   // The converted mesh, kept so that evicted content can be converted 
+   // again when it's needed                                            
+   Ref<const A::Mesh> mContent;
+
+   // Set while the converted content is in memory                      
+   bool mResident = false;
+   // Unique for each adoption of converted content, zero while evicted 
+   // Lets caches keyed by the geometry tell apart content that was     
+   // evicted and converted again, even if it reuses the same memory    
+   uint64_t mVersion = 0;
+   // Size of the converted content in bytes                            
+   size_t mBytes = 0;
+   // The renderer frame, in which the geometry was last used           
+   uint64_t mLastUsed = 0;
+
+   static void Gather(const A::Mesh&, Conversion&);
+   static void Convert(Conversion&);
+   static void Import(Conversion&);
+
 public:
    ASCIIGeometry(ASCIIRenderer*, const Many&);
+   ~ASCIIGeometry();
+
+   bool IsReady() const noexcept;
+   bool Poll();
+   void Request();
+   void Evict();
+   void Touch(uint64_t frame) noexcept;
+   auto GetLastUsed() const noexcept -> uint64_t;
+   auto GetBytes() const noexcept -> size_t;
+   auto GetVersion() const noexcept -> uint64_t;
 
    auto MadeOfTriangles() const noexcept -> bool;
-   auto GetVertices() const noexcept -> const TMany<Vertex>&;
+   auto GetVertices(size_t lod = 0) const noexcept -> const TMany<Vertex>&;
+   auto GetBounds() const noexcept -> const ASCIIBounds&;
+   auto GetLODCount() const noexcept -> size_t;
+   auto SelectLOD(Real pixelsPerUnit) const noexcept -> size_t;
+
+   static void Simplify(::std::vector<Level>&, const ASCIIBounds&);
+
+   /// Pick the coarsest level of simplification, whose error remains         
+   /// smaller than a single pixel                                            
+   ///   @param simplified - the simplified levels, finest first              
+   ///   @param pixelsPerUnit - how many pixels a model space unit covers     
+   ///   @return the level of simplification, zero for the original           
+   static auto SelectLOD(const auto& simplified, Real pixelsPerUnit) noexcept -> size_t {
+      for (auto lod = simplified.size(); lod > 0; --lod) {
+         if (simplified[lod - 1].mError * pixelsPerUnit <= 1)
+            return lod;
+      }
+      return 0;
+   }
 };
@@ -0,0 +1,355 @@
+///                                                                           
+/// Langulus::Module::ASCII                                                   
+/// Copyright (c) 2024 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "ASCIIGeometryCache.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#if defined(_WIN32)
+   #define WIN32_LEAN_AND_MEAN
+   #define NOMINMAX
+   #include <windows.h>
+#else
+   #include <fcntl.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <unistd.h>
+#endif
+
+
+/// Move constructor                                                          
+///   @param other - the mapping to take over                                 
+ASCIIMappedFile::ASCIIMappedFile(ASCIIMappedFile&& other) noexcept {
+   *this = ::std::move(other);
+}
+
+/// Unmap the file                                                            
+ASCIIMappedFile::~ASCIIMappedFile() {
+   Close();
+}
+
+/// Move assignment                                                           
+///   @param other - the mapping to take over                                 
+///   @return a reference to this mapping                                     
+auto ASCIIMappedFile::operator = (ASCIIMappedFile&& other) noexcept -> ASCIIMappedFile& {
+   if (this == &other)
+      return *this;
+
+   Close();
+   mData = other.mData;
+   mSize = other.mSize;
+   other.mData = nullptr;
+   other.mSize = 0;
+   #if defined(_WIN32)
+      mFile = other.mFile;
+      mMapping = other.mMapping;
+      other.mFile = other.mMapping = nullptr;
+   #endif
+   return *this;
+}
+
+/// Map a whole file for reading                                              
+///   @param path - the file to map                                           
+///   @return true if the file was mapped                                     
+bool ASCIIMappedFile::Open(const ::std::filesystem::path& path) noexcept {
+   Close();
+
+   #if defined(_WIN32)
+      mFile = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+         nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (mFile == INVALID_HANDLE_VALUE) {
+         mFile = nullptr;
+         return false;
+      }
+
+      LARGE_INTEGER size;
+      if (not ::GetFileSizeEx(mFile, &size) or not size.QuadPart) {
+         Close();
+         return false;
+      }
+
+      mMapping = ::CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (not mMapping) {
+         Close();
+         return false;
+      }
+
+      mData = static_cast<const ::std::byte*>(
+         ::MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+      if (not mData) {
+         Close();
+         return false;
+      }
+      mSize = static_cast<size_t>(size.QuadPart);
+   #else
+      const int file = ::open(path.c_str(), O_RDONLY);
+      if (file < 0)
+         return false;
+
+      struct stat info;
+      if (::fstat(file, &info) != 0 or info.st_size <= 0) {
+         ::close(file);
+         return false;
+      }
+
+      // The mapping stays valid after the descriptor is closed         
+      const auto size = static_cast<size_t>(info.st_size);
+      void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+      ::close(file);
+      if (data == MAP_FAILED)
+         return false;
+
+      mData = static_cast<const ::std::byte*>(data);
+      mSize = size;
+   #endif
+   return true;
+}
+
+/// Unmap the file, if mapped                                                 
+void ASCIIMappedFile::Close() noexcept {
+   #if defined(_WIN32)
+      if (mData)
+         ::UnmapViewOfFile(mData);
+      if (mMapping)
+         ::CloseHandle(mMapping);
+      if (mFile)
+         ::CloseHandle(mFile);
+      mMapping = mFile = nullptr;
+   #else
+      if (mData)
+         ::munmap(const_cast<::std::byte*>(mData), mSize);
+   #endif
+
+   mData = nullptr;
+   mSize = 0;
+}
+
+/// Get the mapped contents                                                   
+///   @return a pointer to the first byte, or nullptr if not mapped           
+auto ASCIIMappedFile::GetData() const noexcept -> const ::std::byte* {
+   return mData;
+}
+
+/// Get the size of the mapped contents                                       
+///   @return the size in bytes                                               
+auto ASCIIMappedFile::GetSize() const noexcept -> size_t {
+   return mSize;
+}
+
+namespace
+{
+   constexpr char Magic[4] = {'A', 'S', 'C', 'G'};
+
+   // Vertex data is aligned to this, so that it can be used in place   
+   constexpr uint64_t Alignment = 64;
+
+   /// The start of each cache file                                           
+   struct Header {
+      char mMagic[4];
+      uint32_t mVersion;
+      uint64_t mKey;
+      uint32_t mVertexSize;
+      uint32_t mLevelCount;
+      Real mRange[8];
+   };
+
+   /// Follows the header, once for each level                                
+   struct LevelRecord {
+      uint64_t mOffset;
+      uint64_t mCount;
+      Real mError;
+   };
+
+   constexpr uint64_t Align(uint64_t offset) noexcept {
+      return (offset + Alignment - 1) / Alignment * Alignment;
+   }
+}
+
+/// Get the folder for cache files, if none is given explicitly               
+///   @return the folder from LANGULUS_ASCII_CACHE if set, otherwise a folder 
+///      in the user's cache directory, or an empty path if there's none      
+auto ASCIIGeometryCache::GetDefaultFolder() -> ::std::filesystem::path {
+   if (const auto folder = ::std::getenv("LANGULUS_ASCII_CACHE"))
+      return folder;
+
+   #if defined(_WIN32)
+      if (const auto local = ::std::getenv("LOCALAPPDATA"); local and *local)
+         return ::std::filesystem::path {local} / "Langulus" / "ASCII";
+   #else
+      if (const auto cache = ::std::getenv("XDG_CACHE_HOME"); cache and *cache)
+         return ::std::filesystem::path {cache} / "langulus" / "ascii";
+      if (const auto home = ::std::getenv("HOME"); home and *home)
+         return ::std::filesystem::path {home} / ".cache" / "langulus" / "ascii";
+   #endif
+   return {};
+}
+
+/// Construct a cache                                                         
+///   @param folder - where cache files are kept, created on first store,     
+///      or an empty path to disable the cache                                
+ASCIIGeometryCache::ASCIIGeometryCache(::std::filesystem::path folder)
+   : mFolder {::std::move(folder)} {}
+
+/// Check if the cache has a folder to work with                              
+///   @return true if entries are loaded and stored                           
+bool ASCIIGeometryCache::IsEnabled() const noexcept {
+   return not mFolder.empty();
+}
+
+/// Get the file of a cache entry                                             
+///   @param key - the hash of the source content                             
+///   @return the path to the file                                            
+auto ASCIIGeometryCache::GetPath(uint64_t key) const -> ::std::filesystem::path {
+   char name[32];
+   ::std::snprintf(name, sizeof(name), "%016llx.geometry",
+      static_cast<unsigned long long>(key));
+   return mFolder / name;
+}
+
+/// Map a cache entry, and validate it                                        
+///   @param key - the hash of the source content                             
+///   @param vertexSize - the expected size of a single vertex                
+///   @param entry - [out] the loaded entry                                   
+///   @return true if a valid entry was found                                 
+bool ASCIIGeometryCache::Load(uint64_t key, size_t vertexSize, Entry& entry) const noexcept {
+   if (not IsEnabled())
+      return false;
+
+   try {
+      if (not entry.mFile.Open(GetPath(key)))
+         return false;
+   }
+   catch (...) { return false; }
+
+   const auto data = entry.mFile.GetData();
+   const auto size = entry.mFile.GetSize();
+   if (size < sizeof(Header))
+      return false;
+
+   Header header;
+   ::std::memcpy(&header, data, sizeof(Header));
+   if (::std::memcmp(header.mMagic, Magic, sizeof(Magic))
+   or header.mVersion != Version
+   or header.mKey != key
+   or header.mVertexSize != vertexSize
+   or not header.mLevelCount
+   or sizeof(Header) + header.mLevelCount * sizeof(LevelRecord) > size)
+      return false;
+
+   entry.mRange.mMin = {header.mRange[0], header.mRange[1], header.mRange[2], header.mRange[3]};
+   entry.mRange.mMax = {header.mRange[4], header.mRange[5], header.mRange[6], header.mRange[7]};
+
+   try {
+      entry.mLevels.resize(header.mLevelCount);
+   }
+   catch (...) { return false; }
+
+   for (uint32_t i = 0; i < header.mLevelCount; ++i) {
+      LevelRecord record;
+      ::std::memcpy(&record, data + sizeof(Header) + i * sizeof(LevelRecord), sizeof(LevelRecord));
+      if (record.mOffset % Alignment
+      or record.mOffset > size
+      or record.mCount > (size - record.mOffset) / vertexSize)
+         return false;
+
+      entry.mLevels[i] = {data + record.mOffset, record.mCount, record.mError};
+   }
+
+   return true;
+}
+
+/// Write a cache entry, unless one already exists. Entries are keyed by the  
+/// content hash, so an existing entry holds the same data, unless it's from  
+/// an incompatible version, in which case it's replaced                      
+///   @param key - the hash of the source content                             
+///   @param vertexSize - the size of a single vertex                         
+///   @param range - the range of the vertex positions                        
+///   @param levels - the vertex buffers to write                             
+void ASCIIGeometryCache::Store(
+   uint64_t key, size_t vertexSize, const Range4& range,
+   const ::std::vector<Level>& levels
+) const noexcept {
+   if (not IsEnabled())
+      return;
+
+   try {
+      ::std::error_code error;
+      const auto path = GetPath(key);
+      Entry existing;
+      if (::std::filesystem::exists(path, error)
+      and Load(key, vertexSize, existing))
+         return;
+
+      ::std::filesystem::create_directories(mFolder, error);
+      if (error)
+         return;
+
+      Header header {};
+      ::std::memcpy(header.mMagic, Magic, sizeof(Magic));
+      header.mVersion = Version;
+      header.mKey = key;
+      header.mVertexSize = static_cast<uint32_t>(vertexSize);
+      header.mLevelCount = static_cast<uint32_t>(levels.size());
+      const Real rangeData[8] {
+         range.mMin.x, range.mMin.y, range.mMin.z, range.mMin.w,
+         range.mMax.x, range.mMax.y, range.mMax.z, range.mMax.w
+      };
+      ::std::memcpy(header.mRange, rangeData, sizeof(rangeData));
+
+      ::std::vector<LevelRecord> records(levels.size());
+      uint64_t offset = Align(sizeof(Header) + levels.size() * sizeof(LevelRecord));
+      for (size_t i = 0; i < levels.size(); ++i) {
+         records[i] = {offset, levels[i].mCount, levels[i].mError};
+         offset = Align(offset + levels[i].mCount * vertexSize);
+      }
+
+      // Write under a temporary name, unique to this writer, and rename
+      // when complete. Renaming replaces files atomically, so racing   
+      // writers of the same entry just overwrite each other            
+      static ::std::atomic<uint64_t> counter = 0;
+      char suffix[64];
+      ::std::snprintf(suffix, sizeof(suffix), ".%zx.%llx.tmp",
+         ::std::hash<::std::thread::id> {}(::std::this_thread::get_id()),
+         static_cast<unsigned long long>(counter.fetch_add(1)));
+
+      auto temporary = path;
+      temporary += suffix;
+      {
+         ::std::ofstream file {temporary, ::std::ios::binary | ::std::ios::trunc};
+         if (not file)
+            return;
+
+         file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+         file.write(reinterpret_cast<const char*>(records.data()),
+            static_cast<::std::streamsize>(records.size() * sizeof(LevelRecord)));
+
+         const char padding[Alignment] {};
+         for (size_t i = 0; i < levels.size() and file; ++i) {
+            const auto at = static_cast<uint64_t>(file.tellp());
+            file.write(padding, static_cast<::std::streamsize>(records[i].mOffset - at));
+            file.write(static_cast<const char*>(levels[i].mVertices),
+               static_cast<::std::streamsize>(levels[i].mCount * vertexSize));
+         }
+
+         if (not file) {
+            file.close();
+            ::std::filesystem::remove(temporary, error);
+            return;
+         }
+      }
+
+      ::std::filesystem::rename(temporary, path, error);
+      if (error)
+         ::std::filesystem::remove(temporary, error);
+   }
+   catch (...) {}
+}
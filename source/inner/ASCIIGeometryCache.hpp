@@ -0,0 +1,92 @@
+///                                                                           
+/// Langulus::Module::ASCII                                                   
+/// Copyright (c) 2024 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "../Common.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+
+///                                                                           
+///   A read-only memory mapped file                                          
+///                                                                           
+struct ASCIIMappedFile {
+private:
+   const ::std::byte* mData = nullptr;
+   size_t mSize = 0;
+   #if defined(_WIN32)
+      void* mFile = nullptr;
+      void* mMapping = nullptr;
+   #endif
+
+public:
+   ASCIIMappedFile() = default;
+   ASCIIMappedFile(const ASCIIMappedFile&) = delete;
+   ASCIIMappedFile(ASCIIMappedFile&&) noexcept;
+   ~ASCIIMappedFile();
+
+   auto operator = (const ASCIIMappedFile&) -> ASCIIMappedFile& = delete;
+   auto operator = (ASCIIMappedFile&&) noexcept -> ASCIIMappedFile&;
+
+   bool Open(const ::std::filesystem::path&) noexcept;
+   void Close() noexcept;
+
+   auto GetData() const noexcept -> const ::std::byte*;
+   auto GetSize() const noexcept -> size_t;
+};
+
+
+///                                                                           
+///   Persistent cache of converted geometry                                  
+///                                                                           
+///   Converted vertex buffers are written to disk, keyed by the hash of      
+/// their source content, and memory mapped on later runs, so that they can   
+/// be used without any parsing. Files carry a version and the vertex size,   
+/// and are ignored if either doesn't match. Files are written under a        
+/// temporary name unique to the writer, and renamed, so a partially written  
+/// file is never read, and concurrent writers never clash.                   
+///   The folder is taken from the LANGULUS_ASCII_CACHE environment variable, 
+/// or defaults to a folder in the user's cache directory. An empty folder    
+/// disables the cache.                                                       
+///   All functions are safe to call from background jobs, and failures are   
+/// never reported - the cache is only an optimization.                       
+///                                                                           
+struct ASCIIGeometryCache {
+   static constexpr uint32_t Version = 1;
+
+   /// A vertex buffer, either in a mapped file, or to be written             
+   struct Level {
+      const void* mVertices;
+      uint64_t mCount;
+      // The largest distance a vertex was moved by simplification      
+      Real mError;
+   };
+
+   /// A loaded cache entry. The levels point inside the mapped file, so      
+   /// they remain valid only as long as the entry does                       
+   struct Entry {
+      Range4 mRange;
+      ::std::vector<Level> mLevels;
+      ASCIIMappedFile mFile;
+   };
+
+private:
+   ::std::filesystem::path mFolder;
+
+   auto GetPath(uint64_t key) const -> ::std::filesystem::path;
+
+public:
+   static auto GetDefaultFolder() -> ::std::filesystem::path;
+
+   ASCIIGeometryCache(::std::filesystem::path folder = GetDefaultFolder());
+
+   bool IsEnabled() const noexcept;
+   bool Load(uint64_t key, size_t vertexSize, Entry&) const noexcept;
+   void Store(uint64_t key, size_t vertexSize, const Range4&, const ::std::vector<Level>&) const noexcept;
+};
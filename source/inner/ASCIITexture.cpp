@@ -6,28 +6,223 @@
 /// SPDX-License-Identifier: GPL-3.0-or-later                                 
 ///                                                                           
 #include "../ASCII.hpp"
+#include <algorithm>
+#include <cmath>
 
 
 /// Texture constructor                                                       
+/// Conversion of the image is submitted as a background job, and the         
+/// texture has no mips until Poll() reports it's done                        
 ///   @param producer - the texture producer                                  
 ///   @param descriptor - the texture descriptor                              
 ASCIITexture::ASCIITexture(ASCIIRenderer* producer, const Many& descriptor)
    : Resolvable   {this}
-   , ProducedFrom {producer, descriptor}
-   , mImage       {producer} {
+   , ProducedFrom {producer, descriptor} {
    descriptor.ForEachDeep([&](const A::Image& content) {
-      Upload(content);
+      if (not mContent)
+         mContent = &content;
    });
+
+   Request();
+}
+
+/// Cancel the conversion if it hasn't started yet. A running conversion is   
+/// left to finish on its own - it touches only its shared state              
+ASCIITexture::~ASCIITexture() {
+   if (not mConversion)
+      return;
+
+   int expected = Conversion::Queued;
+   mConversion->mState.compare_exchange_strong(expected, Conversion::Cancelled);
+}
+
+/// Submit a background conversion, unless the content is already in memory,  
+/// or is being converted. Without content, the texture never gets any mips.  
+/// The texels are read from the image here, so that the background job works 
+/// only on plain data                                                        
+void ASCIITexture::Request() {
+   if (mResident or mConversion or not mContent)
+      return;
+
+   auto conversion = ::std::make_shared<Conversion>();
+   try {
+      const auto& view = mContent->GetView();
+      conversion->mWidth = static_cast<int>(view.mWidth);
+      conversion->mHeight = static_cast<int>(view.mHeight);
+      LANGULUS_ASSERT(conversion->mWidth > 0 and conversion->mHeight > 0,
+         Graphics, "Empty image");
+
+      // Read the top mip, converted to RGBA8                           
+      conversion->mTop.resize(static_cast<size_t>(conversion->mWidth) * conversion->mHeight);
+      auto it = mContent->begin();
+      for (auto& texel : conversion->mTop)
+         texel = (it++).As<RGBA>();
+   }
+   catch (...) {
+      // Failed conversions still count as resident, so that they       
+      // aren't attempted again on each frame                           
+      mResident = true;
+      throw;
+   }
+
+   mConversion = ::std::move(conversion);
+   GetProducer()->GetProducer()->GetWorkers().Submit([conversion = mConversion] {
+      int expected = Conversion::Queued;
+      if (not conversion->mState.compare_exchange_strong(expected, Conversion::Running))
+         return;
+
+      try {
+         conversion->mResult = BuildMipChain(
+            ::std::move(conversion->mTop), conversion->mWidth, conversion->mHeight);
+      }
+      catch (...) { conversion->mException = ::std::current_exception(); }
+      conversion->mState.store(Conversion::Done, ::std::memory_order_release);
+   });
+}
+
+/// Check on the background conversion, and adopt its results if it's done    
+/// Must be called on the thread that owns the texture                        
+///   @return true if the texture can be sampled                              
+bool ASCIITexture::Poll() {
+   if (mResident)
+      return GetMipCount() > 0;
+   if (not mConversion
+   or mConversion->mState.load(::std::memory_order_acquire) != Conversion::Done)
+      return false;
+
+   const auto conversion = ::std::move(mConversion);
+   mResident = true;
+   if (conversion->mException)
+      ::std::rethrow_exception(conversion->mException);
+
+   // Adopt the whole chain as a single block                           
+   auto& result = conversion->mResult;
+   mMips = ::std::move(result.mMips);
+   mTexels.Clear();
+   mTexels.New(result.mTexels.size());
+   ::std::copy_n(result.mTexels.data(), result.mTexels.size(), mTexels.GetRaw());
+   return GetMipCount() > 0;
+}
+
+/// Release the uploaded content. The texture can't be used until it's        
+/// requested, and converted again                                            
+void ASCIITexture::Evict() {
+   if (not mResident or not mContent)
+      return;
+
+   mTexels.Reset();
+   mMips.clear();
+   mResident = false;
 }
 
-/// Initialize from the provided content                                      
-///   @param content - the abstract texture content interface                 
-void ASCIITexture::Upload(const A::Image&) {
-   TODO(); //compile into intermediate format
+/// Mark the texture as used                                                  
+///   @param frame - the current renderer frame                               
+void ASCIITexture::Touch(uint64_t frame) noexcept {
+   mLastUsed = frame;
 }
 
-/// Get the image                                                             
-///   @return a reference to the image                                        
-auto ASCIITexture::GetImage() const noexcept -> const ASCIIImage& {
-   return mImage;
+/// Get the renderer frame, in which the texture was last used                
+///   @return the frame                                                       
+auto ASCIITexture::GetLastUsed() const noexcept -> uint64_t {
+   return mLastUsed;
+}
+
+/// Get the size of the uploaded content                                      
+///   @return the size in bytes, zero if not resident                         
+auto ASCIITexture::GetBytes() const noexcept -> size_t {
+   if (not mResident)
+      return 0;
+
+   return mTexels.GetCount() * sizeof(RGBA);
+}
+
+/// Generate a mip chain down to a single texel, each mip a box-filtered      
+/// half of the previous one. At the resolution of a terminal almost every    
+/// access minifies, so most sampling hits the small mips. Each mip is stored 
+/// in tiles, for 2D locality. Executed in the background, so it must not     
+/// touch the allocator                                                       
+///   @param top - the top mip, row by row                                    
+///   @param width - width of the top mip, must be positive                   
+///   @param height - height of the top mip, must be positive                 
+///   @return the tiled mip chain                                             
+auto ASCIITexture::BuildMipChain(
+   ::std::vector<RGBA>&& top, int width, int height
+) -> MipChain {
+   MipChain result;
+   auto mip = ::std::move(top);
+
+   // Lay out all mips, each padded to whole tiles                      
+   size_t total = 0;
+   for (int w = width, h = height;; w = ::std::max(w / 2, 1), h = ::std::max(h / 2, 1)) {
+      const int tilesx = (w + TileSize - 1) / TileSize;
+      const int tilesy = (h + TileSize - 1) / TileSize;
+      result.mMips.push_back({w, h, tilesx, total});
+      total += static_cast<size_t>(tilesx) * tilesy * TileSize * TileSize;
+      if (w == 1 and h == 1)
+         break;
+   }
+
+   result.mTexels.resize(total);
+
+   for (const auto& m : result.mMips) {
+      if (m.mWidth != width or m.mHeight != height) {
+         // Downsample the previous mip with a box filter               
+         ::std::vector<RGBA> next(static_cast<size_t>(m.mWidth) * m.mHeight);
+         for (int y = 0; y < m.mHeight; ++y) {
+            const int y0 = ::std::min(y * 2,     height - 1);
+            const int y1 = ::std::min(y * 2 + 1, height - 1);
+            for (int x = 0; x < m.mWidth; ++x) {
+               const int x0 = ::std::min(x * 2,     width - 1);
+               const int x1 = ::std::min(x * 2 + 1, width - 1);
+               const auto& a = mip[y0 * width + x0];
+               const auto& b = mip[y0 * width + x1];
+               const auto& c = mip[y1 * width + x0];
+               const auto& d = mip[y1 * width + x1];
+
+               auto& out = next[y * m.mWidth + x];
+               for (int i = 0; i < 4; ++i)
+                  out[i] = static_cast<uint8_t>((a[i] + b[i] + c[i] + d[i] + 2) / 4);
+            }
+         }
+
+         mip = ::std::move(next);
+         width = m.mWidth;
+         height = m.mHeight;
+      }
+
+      // Scatter the mip into tiles                                     
+      auto tiled = result.mTexels.data() + m.mOffset;
+      for (int y = 0; y < height; ++y) {
+         for (int x = 0; x < width; ++x) {
+            tiled[((y / TileSize) * m.mTiles + x / TileSize) * TileSize * TileSize
+               + (y % TileSize) * TileSize + x % TileSize] = mip[y * width + x];
+         }
+      }
+   }
+
+   return result;
+}
+
+/// Get the number of mips                                                    
+///   @return the number of mips, zero if the texture isn't ready to be       
+///      sampled - it has no content, or it's still being converted           
+auto ASCIITexture::GetMipCount() const noexcept -> int {
+   return static_cast<int>(mMips.size());
+}
+
+/// Pick the mip, whose texels are closest to the size of a pixel             
+///   @param dx - change of texture coordinates between horizontal pixels     
+///   @param dy - change of texture coordinates between vertical pixels       
+///   @return the mip index                                                   
+auto ASCIITexture::SelectMip(const Vec2& dx, const Vec2& dy) const noexcept -> int {
+   const Real w = mMips[0].mWidth;
+   const Real h = mMips[0].mHeight;
+   const Real texels = ::std::max(
+      ::std::hypot(dx.x * w, dx.y * h),
+      ::std::hypot(dy.x * w, dy.y * h)
+   );
+
+   if (texels <= 1)
+      return 0;
+   return ::std::min(static_cast<int>(::std::log2(texels)), GetMipCount() - 1);
 }
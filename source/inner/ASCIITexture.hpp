@@ -7,6 +7,10 @@
 ///                                                                           
 #pragma once
 #include "ASCIIBuffer.hpp"
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <vector>
 
 
 ///                                                                           
@@ -18,13 +22,87 @@ struct ASCIITexture : A::Graphics, ProducedFrom<ASCIIRenderer> {
    LANGULUS(ABSTRACT) false;
    LANGULUS_BASES(A::Graphics);
 
+   // Texels are grouped in square tiles, so that neighboring texels in 
+   // both directions are likely to share a cache line                  
+   static constexpr int TileSize = 4;
+
+   // A single level of the mip chain                                   
+   struct Mip {
+      int mWidth;
+      int mHeight;
+      // Number of tiles in a row                                       
+      int mTiles;
+      // Offset of the first texel in the texel array                   
+      size_t mOffset;
+   };
+
+   // A tiled mip chain, kept in standard containers until adopted      
+   struct MipChain {
+      ::std::vector<RGBA> mTexels;
+      ::std::vector<Mip> mMips;
+   };
+
 private:
-   ASCIIImage mImage;
+   // All texels of all mips, each mip half the size of the previous    
+   TMany<RGBA> mTexels;
+   ::std::vector<Mip> mMips;
+
+   // A conversion running in the background. It's shared with the job, 
+   // so that the texture can be discarded at any time. The job never   
+   // touches the image, only the texels that were copied from it       
+   struct Conversion {
+      enum State : int {
+         Queued, Running, Done, Cancelled
+      };
+
+      ::std::atomic<int> mState = Queued;
+      // The top mip, copied on the thread that owns the texture        
+      ::std::vector<RGBA> mTop;
+      int mWidth = 0;
+      int mHeight = 0;
+      // Results, adopted by Poll() once the state is Done              
+      MipChain mResult;
+      // Errors are rethrown when adopting the results                  
+      ::std::exception_ptr mException;
+   };
 
-   void Upload(const A::Image&);
+   ::std::shared_ptr<Conversion> mConversion;
+
+   // The uploaded image, kept so that evicted content can be uploaded  
+   // again when it's needed                                            
+   Ref<const A::Image> mContent;
+   // Set while the uploaded content is in memory                       
+   bool mResident = false;
+   // The renderer frame, in which the texture was last used            
+   uint64_t mLastUsed = 0;
 
 public:
    ASCIITexture(ASCIIRenderer*, const Many&);
+   ~ASCIITexture();
+
+   static auto BuildMipChain(::std::vector<RGBA>&& top, int width, int height) -> MipChain;
+
+   auto GetMipCount() const noexcept -> int;
+   auto SelectMip(const Vec2&, const Vec2&) const noexcept -> int;
+
+   /// Sample the texel nearest to a texture coordinate, wrapping it around   
+   ///   @param uv - the texture coordinate                                   
+   ///   @param mip - the mip to sample, see SelectMip                        
+   ///   @return the texel color                                              
+   auto Sample(const Vec2& uv, int mip) const noexcept -> RGBAf {
+      const auto& m = mMips[mip];
+      const auto x = ::std::min(static_cast<int>((uv.x - ::std::floor(uv.x)) * m.mWidth),  m.mWidth  - 1);
+      const auto y = ::std::min(static_cast<int>((uv.y - ::std::floor(uv.y)) * m.mHeight), m.mHeight - 1);
+      const auto& texel = mTexels.GetRaw()[m.mOffset
+         + ((y / TileSize) * m.mTiles + x / TileSize) * TileSize * TileSize
+         + (y % TileSize) * TileSize + x % TileSize];
+      return {texel[0] / 255.0f, texel[1] / 255.0f, texel[2] / 255.0f, texel[3] / 255.0f};
+   }
 
-   auto GetImage() const noexcept -> const ASCIIImage&;
+   bool Poll();
+   void Request();
+   void Evict();
+   void Touch(uint64_t frame) noexcept;
+   auto GetLastUsed() const noexcept -> uint64_t;
+   auto GetBytes() const noexcept -> size_t;
 };
@@ -0,0 +1,187 @@
+///                                                                           
+/// Langulus::Module::ASCII                                                   
+/// Copyright (c) 2024 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "ASCIIThreadPool.hpp"
+
+
+/// Start the workers                                                         
+///   @param workers - number of threads that can execute tasks, including    
+///      the calling one, so one less is actually spawned                     
+ASCIIThreadPool::ASCIIThreadPool(unsigned workers) {
+   const auto spawned = workers > 1 ? workers - 1 : 0;
+   for (unsigned i = 0; i < spawned; ++i)
+      mQueues.emplace_back(::std::make_unique<Queue>());
+   for (unsigned i = 0; i < spawned; ++i)
+      mThreads.emplace_back(&ASCIIThreadPool::Work, this, i);
+}
+
+/// Stop and join all workers. Background jobs that haven't started yet are   
+/// discarded                                                                 
+ASCIIThreadPool::~ASCIIThreadPool() {
+   {
+      const ::std::scoped_lock lock {mWakeMutex};
+      mQuit = true;
+   }
+   mWake.notify_all();
+
+   for (auto& thread : mThreads)
+      thread.join();
+}
+
+/// Get the number of spawned worker threads                                  
+///   @return the number of workers, not counting callers of ParallelFor      
+auto ASCIIThreadPool::GetWorkerCount() const noexcept -> size_t {
+   return mThreads.size();
+}
+
+/// Pop a task from the home queue, or steal one from another queue, and      
+/// execute it. Exceptions are kept in the task's group, which is always      
+/// notified that the task is done                                            
+///   @param home - the queue to try first                                    
+///   @return true if a task was executed                                     
+bool ASCIIThreadPool::TryRun(size_t home) {
+   if (not mQueued.load(::std::memory_order_acquire))
+      return false;
+
+   for (size_t i = 0; i < mQueues.size(); ++i) {
+      auto& queue = *mQueues[(home + i) % mQueues.size()];
+      Task task;
+      {
+         const ::std::scoped_lock lock {queue.mMutex};
+         if (queue.mTasks.empty())
+            continue;
+
+         // Own tasks are taken from the front, stolen ones from back   
+         if (i == 0) {
+            task = queue.mTasks.front();
+            queue.mTasks.pop_front();
+         }
+         else {
+            task = queue.mTasks.back();
+            queue.mTasks.pop_back();
+         }
+      }
+
+      --mQueued;
+      try { (*task.mCall)(task.mIndex); }
+      catch (...) {
+         const ::std::scoped_lock lock {task.mGroup->mErrorMutex};
+         if (not task.mGroup->mError)
+            task.mGroup->mError = ::std::current_exception();
+      }
+
+      task.mGroup->mRemaining.fetch_sub(1, ::std::memory_order_acq_rel);
+      return true;
+   }
+
+   return false;
+}
+
+/// Pop a background job and execute it                                       
+///   @return true if a job was executed                                      
+bool ASCIIThreadPool::TryRunBackground() {
+   ::std::function<void()> job;
+   {
+      const ::std::scoped_lock lock {mWakeMutex};
+      if (mBackground.empty())
+         return false;
+
+      job = ::std::move(mBackground.front());
+      mBackground.pop_front();
+   }
+
+   job();
+   return true;
+}
+
+/// The worker loop                                                           
+///   @param home - the index of the worker's own queue                       
+void ASCIIThreadPool::Work(size_t home) {
+   while (true) {
+      if (TryRun(home) or TryRunBackground())
+         continue;
+
+      ::std::unique_lock lock {mWakeMutex};
+      mWake.wait(lock, [this] {
+         return mQuit or mQueued.load(::std::memory_order_acquire)
+             or not mBackground.empty();
+      });
+      if (mQuit)
+         return;
+   }
+}
+
+/// Execute a function for each index in [0; count), in parallel, and wait    
+/// for all of them to finish. The caller takes part in the execution         
+///   @param count - number of indices                                        
+///   @param call - the function to execute for each index                    
+///   @throw the first exception thrown by any index, after all are done      
+void ASCIIThreadPool::ParallelFor(
+   size_t count, const ::std::function<void(size_t)>& call
+) {
+   if (not count)
+      return;
+
+   if (count == 1 or mQueues.empty()) {
+      // Not worth distributing                                         
+      ::std::exception_ptr error;
+      for (size_t i = 0; i < count; ++i) {
+         try { call(i); }
+         catch (...) {
+            if (not error)
+               error = ::std::current_exception();
+         }
+      }
+
+      if (error)
+         ::std::rethrow_exception(error);
+      return;
+   }
+
+   // Tasks are counted only once pushed, and inside the queue lock, so 
+   // that they're never popped before they're counted                  
+   Group group {count};
+   const auto first = mNextQueue.fetch_add(1) % mQueues.size();
+   for (size_t i = 0; i < count; ++i) {
+      auto& queue = *mQueues[(first + i) % mQueues.size()];
+      const ::std::scoped_lock lock {queue.mMutex};
+      queue.mTasks.push_back({&call, i, &group});
+      mQueued.fetch_add(1, ::std::memory_order_release);
+   }
+
+   // Workers check mQueued under the wake mutex before sleeping, so    
+   // passing through it guarantees they either saw the tasks, or are   
+   // already waiting for this notification                             
+   { const ::std::scoped_lock lock {mWakeMutex}; }
+   mWake.notify_all();
+
+   // Help until the group is done - any task might be executed here,   
+   // which is what makes nested calls safe                             
+   while (group.mRemaining.load(::std::memory_order_acquire)) {
+      if (not TryRun(first))
+         ::std::this_thread::yield();
+   }
+
+   if (group.mError)
+      ::std::rethrow_exception(group.mError);
+}
+
+/// Submit a job to be executed in the background, without waiting for it     
+/// If there are no workers, the job is executed immediately                  
+///   @param job - the job to execute                                         
+void ASCIIThreadPool::Submit(::std::function<void()>&& job) {
+   if (mThreads.empty()) {
+      job();
+      return;
+   }
+
+   {
+      const ::std::scoped_lock lock {mWakeMutex};
+      mBackground.push_back(::std::move(job));
+   }
+   mWake.notify_one();
+}
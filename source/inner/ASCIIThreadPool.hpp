@@ -0,0 +1,86 @@
+///                                                                           
+/// Langulus::Module::ASCII                                                   
+/// Copyright (c) 2024 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "../Common.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+///                                                                           
+///   A work-stealing thread pool                                             
+///                                                                           
+///   Each worker owns a task queue, pops tasks from its front, and steals    
+/// from the back of other workers' queues when it runs dry. The thread that  
+/// calls ParallelFor helps executing tasks until its own are done, so calls  
+/// can be nested safely, i.e. a task can ParallelFor by itself.              
+///   Background jobs can also be submitted without waiting for them. They    
+/// are executed only by workers, and only when there's nothing else to do,   
+/// so they never delay a ParallelFor caller.                                 
+///   An exception thrown by a task doesn't stop the other tasks of the same  
+/// ParallelFor call - the first one is rethrown on the caller, once they're  
+/// all done.                                                                 
+///   Tasks must not touch the framework's allocator, or any unit state that  
+/// isn't immutable while the pool is running - the pool is meant only for    
+/// pure number crunching over prepared data.                                 
+///                                                                           
+struct ASCIIThreadPool {
+private:
+   /// A group of tasks, spawned by a single ParallelFor call                 
+   struct Group {
+      ::std::atomic<size_t> mRemaining;
+      // The first exception thrown by any of the tasks                 
+      ::std::mutex mErrorMutex;
+      ::std::exception_ptr mError;
+   };
+
+   /// A single task, one index of a ParallelFor call                         
+   struct Task {
+      const ::std::function<void(size_t)>* mCall;
+      size_t mIndex;
+      Group* mGroup;
+   };
+
+   /// A task queue, owned by a single worker                                 
+   struct Queue {
+      ::std::mutex mMutex;
+      ::std::deque<Task> mTasks;
+   };
+
+   ::std::vector<::std::unique_ptr<Queue>> mQueues;
+   ::std::vector<::std::thread> mThreads;
+
+   // Wakes sleeping workers when new tasks arrive                      
+   ::std::mutex mWakeMutex;
+   ::std::condition_variable mWake;
+   // Background jobs, guarded by the wake mutex                        
+   ::std::deque<::std::function<void()>> mBackground;
+   // Number of tasks pushed, but not yet popped                        
+   ::std::atomic<size_t> mQueued = 0;
+   // Next queue to push to, distributes tasks round-robin              
+   ::std::atomic<size_t> mNextQueue = 0;
+   bool mQuit = false;
+
+   bool TryRun(size_t home);
+   bool TryRunBackground();
+   void Work(size_t home);
+
+public:
+   ASCIIThreadPool(unsigned workers = ::std::thread::hardware_concurrency());
+   ~ASCIIThreadPool();
+
+   auto GetWorkerCount() const noexcept -> size_t;
+   void ParallelFor(size_t count, const ::std::function<void(size_t)>&);
+   void Submit(::std::function<void()>&&);
+};
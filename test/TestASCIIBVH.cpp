@@ -0,0 +1,133 @@
+///                                                                           
+/// Langulus::Module::ASCII                                                   
+/// Copyright (c) 2024 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "../source/inner/ASCIIBVH.hpp"
+#include <Langulus/Testing.hpp>
+#include <random>
+#include <set>
+
+
+namespace
+{
+   /// Make a small box around a point                                        
+   ASCIIBounds Box(Real x, Real y, Real z, Real size = 0.2) {
+      const Vec3 half {size / 2, size / 2, size / 2};
+      return {Vec3 {x, y, z} - half, Vec3 {x, y, z} + half};
+   }
+
+   /// Collect the values of all proxies inside the [-1; 1] clip volume       
+   std::set<size_t> Visible(const ASCIIBVH& bvh) {
+      std::set<size_t> result;
+      bvh.Query(Mat4 {}, [&](size_t value) {
+         REQUIRE(result.insert(value).second);
+      });
+      return result;
+   }
+}
+
+SCENARIO("Culling through a dynamic BVH", "[bvh]") {
+   GIVEN("A row of ten boxes, two of which are inside the clip volume") {
+      ASCIIBVH bvh;
+      int proxies[10];
+      for (int i = 0; i < 10; ++i)
+         proxies[i] = bvh.CreateProxy(Box(i - 4.5, 0, 0), i);
+
+      REQUIRE(bvh.GetProxyCount() == 10);
+      REQUIRE(Visible(bvh) == std::set<size_t> {4, 5});
+
+      WHEN("A box moves into the clip volume") {
+         REQUIRE(bvh.MoveProxy(proxies[9], Box(0, 0.5, 0)));
+
+         THEN("It is reported") {
+            REQUIRE(Visible(bvh) == std::set<size_t> {4, 5, 9});
+         }
+      }
+
+      WHEN("A box moves out of the clip volume") {
+         REQUIRE(bvh.MoveProxy(proxies[4], Box(0, 5, 0)));
+
+         THEN("It is no longer reported") {
+            REQUIRE(Visible(bvh) == std::set<size_t> {5});
+         }
+      }
+
+      WHEN("A box moves only within its fattened bounds") {
+         THEN("The tree isn't modified") {
+            REQUIRE_FALSE(bvh.MoveProxy(proxies[5], Box(0.501, 0, 0)));
+            REQUIRE(Visible(bvh) == std::set<size_t> {4, 5});
+         }
+      }
+
+      WHEN("A box is removed, and its value is changed") {
+         bvh.DestroyProxy(proxies[4]);
+         bvh.SetValue(proxies[5], 50);
+
+         THEN("Only the remaining box is reported, with the new value") {
+            REQUIRE(bvh.GetProxyCount() == 9);
+            REQUIRE(bvh.GetValue(proxies[5]) == 50);
+            REQUIRE(Visible(bvh) == std::set<size_t> {50});
+         }
+      }
+
+      WHEN("Queried with a custom test") {
+         std::set<size_t> found;
+         bvh.Query([](const ASCIIBounds& bounds) {
+            return bounds.mMax.x < 2;
+         }, [&](size_t value) {
+            found.insert(value);
+         });
+
+         THEN("Only boxes the test doesn't reject are reported") {
+            REQUIRE(found == std::set<size_t> {7, 8, 9});
+         }
+      }
+
+      WHEN("The tree is cleared") {
+         bvh.Clear();
+
+         THEN("Nothing is reported") {
+            REQUIRE(bvh.GetProxyCount() == 0);
+            REQUIRE(Visible(bvh).empty());
+         }
+      }
+   }
+
+   GIVEN("Many random boxes, inserted and removed") {
+      ASCIIBVH bvh;
+      std::mt19937 random {1234};
+      std::uniform_real_distribution<Real> coordinate {-4, 4};
+
+      std::vector<std::pair<int, ASCIIBounds>> live;
+      for (size_t i = 0; i < 2000; ++i) {
+         const auto box = Box(coordinate(random), coordinate(random), coordinate(random));
+         live.emplace_back(bvh.CreateProxy(box, i), box);
+
+         // Remove every third box, to exercise rebalancing             
+         if (i % 3 == 2) {
+            const auto victim = random() % live.size();
+            bvh.DestroyProxy(live[victim].first);
+            live.erase(live.begin() + victim);
+         }
+      }
+
+      WHEN("Queried") {
+         const auto visible = Visible(bvh);
+
+         THEN("Exactly the boxes whose fattened bounds overlap are reported") {
+            const ASCIIBounds clip {Vec3 {-1, -1, -1}, Vec3 {1, 1, 1}};
+            std::set<size_t> expected;
+            for (auto& [proxy, box] : live) {
+               if (box.Fatten(0.1).Intersects(clip))
+                  expected.insert(bvh.GetValue(proxy));
+            }
+
+            REQUIRE(bvh.GetProxyCount() == live.size());
+            REQUIRE(visible == expected);
+         }
+      }
+   }
+}
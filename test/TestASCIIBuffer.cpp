@@ -0,0 +1,394 @@
+///                                                                           
+/// Langulus::Module::ASCII                                                   
+/// Copyright (c) 2024 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "../source/inner/ASCIIBuffer.hpp"
+#include <Langulus/Testing.hpp>
+#include <cmath>
+
+
+SCENARIO("Bulk operations on ASCII buffers", "[buffer]") {
+   static Allocator::State memoryState;
+
+   GIVEN("An 8x6 buffer filled with zeroes") {
+      ASCIIBuffer<int> buffer;
+      buffer.Resize(8, 6);
+      buffer.Fill(0);
+
+      REQUIRE(buffer.GetWidth() == 8);
+      REQUIRE(buffer.GetHeight() == 6);
+      REQUIRE(buffer.Matches(0));
+
+      WHEN("A rectangle is filled, partially outside the buffer") {
+         buffer.Fill({6, 4, 4, 4}, 7);
+
+         THEN("Only the clipped rectangle changes") {
+            for (int y = 0; y < 6; ++y) {
+               for (int x = 0; x < 8; ++x)
+                  REQUIRE(buffer.Get(x, y) == (x >= 6 and y >= 4 ? 7 : 0));
+            }
+         }
+      }
+
+      WHEN("Full rows are filled") {
+         buffer.Fill({0, 1, 8, 2}, 3);
+
+         THEN("Only those rows change") {
+            REQUIRE(buffer.GetRow(0)[0] == 0);
+            REQUIRE(buffer.GetRow(1)[0] == 3);
+            REQUIRE(buffer.GetRow(2)[7] == 3);
+            REQUIRE(buffer.GetRow(3)[7] == 0);
+         }
+      }
+
+      WHEN("Another buffer is copied, whole and by rectangle") {
+         ASCIIBuffer<int> other;
+         other.Resize(8, 6);
+         for (int y = 0; y < 6; ++y) {
+            for (int x = 0; x < 8; ++x)
+               other.Get(x, y) = y * 8 + x;
+         }
+
+         ASCIIBuffer<int> part;
+         part.Resize(8, 6);
+         part.Fill(0);
+         part.Copy(other, {2, 2, 3, 2});
+         buffer.Copy(other);
+
+         THEN("Pixels are copied at the same coordinates") {
+            REQUIRE(buffer.Matches(other));
+            for (int y = 0; y < 6; ++y) {
+               for (int x = 0; x < 8; ++x) {
+                  const bool inside = x >= 2 and x < 5 and y >= 2 and y < 4;
+                  REQUIRE(part.Get(x, y) == (inside ? y * 8 + x : 0));
+               }
+            }
+         }
+      }
+
+      WHEN("Another buffer is copied through a mask") {
+         ASCIIBuffer<int> other;
+         other.Resize(8, 6);
+         other.Fill(5);
+
+         ASCIIBuffer<uint8_t> mask;
+         mask.Resize(8, 6);
+         mask.Fill(0);
+         mask.Get(1, 1) = 1;
+         mask.Get(7, 5) = 1;
+
+         buffer.CopyMasked(other, mask);
+
+         THEN("Only the masked pixels change") {
+            for (int y = 0; y < 6; ++y) {
+               for (int x = 0; x < 8; ++x)
+                  REQUIRE(buffer.Get(x, y) == (mask.Get(x, y) ? 5 : 0));
+            }
+         }
+      }
+
+      WHEN("The buffer is converted to another type") {
+         buffer.Fill({0, 0, 4, 6}, 2);
+         ASCIIBuffer<float> out;
+         buffer.Convert(out, [](int v) noexcept { return v * 0.5f; });
+
+         THEN("Each pixel is converted") {
+            REQUIRE(out.GetWidth() == 8);
+            REQUIRE(out.GetHeight() == 6);
+            REQUIRE(out.Get(3, 5) == 1.0f);
+            REQUIRE(out.Get(4, 5) == 0.0f);
+         }
+      }
+   }
+
+   REQUIRE(memoryState.Assert());
+}
+
+SCENARIO("Bulk operations on ASCII images", "[buffer]") {
+   static Allocator::State memoryState;
+
+   GIVEN("Two 10x4 images") {
+      ASCIIImage image {nullptr};
+      image.Resize(10, 4);
+      image.Fill(" ", Colors::White, Colors::Black);
+
+      ASCIIImage other {nullptr};
+      other.Resize(10, 4);
+      other.Fill("#", Colors::Red, Colors::Blue);
+
+      REQUIRE(image.MatchesColor(Colors::Black));
+      REQUIRE_FALSE(image.Matches(other));
+
+      WHEN("A rectangle is filled") {
+         image.Fill({8, 2, 5, 5}, "#", Colors::Red, Colors::Blue);
+
+         THEN("Only the clipped rectangle changes") {
+            for (int y = 0; y < 4; ++y) {
+               for (int x = 0; x < 10; ++x) {
+                  const auto pixel = image.GetPixel(x, y);
+                  const bool inside = x >= 8 and y >= 2;
+                  REQUIRE((pixel.mSymbol == "#") == inside);
+                  REQUIRE(pixel.mBgColor == (inside ? RGBAf {Colors::Blue} : RGBAf {Colors::Black}));
+               }
+            }
+         }
+      }
+
+      WHEN("The other image is copied, whole and by rectangle") {
+         ASCIIImage part {nullptr};
+         part.Resize(10, 4);
+         part.Fill(" ");
+         part.Copy(other, {0, 1, 2, 2});
+         image.Copy(other);
+
+         THEN("All planes are copied") {
+            REQUIRE(image.Matches(other));
+            REQUIRE(part.GetPixel(1, 2).mSymbol == "#");
+            REQUIRE(part.GetPixel(1, 2).mFgColor == RGBAf {Colors::Red});
+            REQUIRE(part.GetPixel(2, 2).mSymbol == " ");
+            REQUIRE(part.GetPixel(1, 3).mSymbol == " ");
+         }
+      }
+
+      WHEN("The other image is copied through a mask") {
+         ASCIIBuffer<uint8_t> mask;
+         mask.Resize(10, 4);
+         mask.Fill(0);
+         mask.Get(3, 0) = 1;
+
+         image.CopyMasked(other, mask);
+
+         THEN("Only the masked pixels change") {
+            REQUIRE(image.GetPixel(3, 0).mSymbol == "#");
+            REQUIRE(image.GetPixel(3, 0).mBgColor == RGBAf {Colors::Blue});
+            REQUIRE(image.GetPixel(4, 0).mSymbol == " ");
+            REQUIRE(image.GetPixel(3, 1).mBgColor == RGBAf {Colors::Black});
+         }
+      }
+
+      WHEN("The other image is blended on top") {
+         RGBAf translucent {0, 0, 1, 0.25f};
+         RGBAf opaque {0, 0, 1, 1};
+         other.Fill({0, 0, 5, 4}, "#", Colors::Red, translucent);
+         other.Fill({5, 0, 5, 4}, "@", Colors::Red, opaque);
+
+         image.Blend(other);
+
+         THEN("Colors are mixed by alpha, symbols are taken only if opaque") {
+            REQUIRE(image.GetPixel(0, 0).mSymbol == " ");
+            REQUIRE(::std::abs(image.GetPixel(0, 0).mBgColor.b - 0.25f) < 0.001f);
+            REQUIRE(image.GetPixel(9, 3).mSymbol == "@");
+            REQUIRE(::std::abs(image.GetPixel(9, 3).mBgColor.b - 1.0f) < 0.001f);
+         }
+      }
+
+      WHEN("The image is converted to true color") {
+         image.Fill({0, 0, 1, 1}, "#", Colors::Red, Colors::Blue);
+         ASCIIBuffer<RGBAf> out;
+         image.Convert(out);
+
+         THEN("Empty symbols take the background, others the foreground") {
+            REQUIRE(out.Get(0, 0) == RGBAf {Colors::Red});
+            REQUIRE(out.Get(1, 0) == RGBAf {Colors::Black});
+         }
+      }
+   }
+
+   REQUIRE(memoryState.Assert());
+}
+
+SCENARIO("Compositing ASCII images through coverage", "[buffer]") {
+   static Allocator::State memoryState;
+
+   GIVEN("Two 10x4 images, and a coverage mask") {
+      ASCIIImage image {nullptr};
+      image.Resize(10, 4);
+      image.Fill(" ", Colors::White, Colors::Black);
+
+      ASCIIImage other {nullptr};
+      other.Resize(10, 4);
+      other.Fill("#", Colors::Red, Colors::Blue);
+
+      ASCIICoverage coverage;
+      coverage.Resize(10, 4);
+      REQUIRE(coverage.IsEmpty());
+
+      // Row 1 is a solid run, row 2 has a gap, rows 0 and 3 are empty  
+      for (int x = 2; x < 6; ++x)
+         coverage.Mark(x, 1);
+      coverage.Mark(1, 2);
+      coverage.Mark(8, 2);
+      coverage.Mark(8, 2);
+
+      REQUIRE_FALSE(coverage.IsEmpty());
+      REQUIRE(coverage.GetCount() == 6);
+      REQUIRE(coverage.GetSpan(0).IsEmpty());
+      REQUIRE(coverage.GetSpan(1).mBegin == 2);
+      REQUIRE(coverage.GetSpan(1).mEnd == 6);
+      REQUIRE(coverage.GetSpan(1).IsSolid());
+      REQUIRE(coverage.GetSpan(2).mBegin == 1);
+      REQUIRE(coverage.GetSpan(2).mEnd == 9);
+      REQUIRE(coverage.GetSpan(2).mCount == 2);
+      REQUIRE_FALSE(coverage.GetSpan(2).IsSolid());
+
+      WHEN("The other image is copied through the coverage") {
+         image.CopyMasked(other, coverage);
+
+         THEN("Only covered pixels change") {
+            for (int y = 0; y < 4; ++y) {
+               for (int x = 0; x < 10; ++x) {
+                  const bool covered = coverage.GetMask().GetRow(y)[x];
+                  REQUIRE((image.GetPixel(x, y).mSymbol == "#") == covered);
+               }
+            }
+         }
+      }
+
+      WHEN("The other image is copied through the coverage, filling the rest") {
+         image.Fill("?");
+         image.CopyMaskedOrFill(other, coverage, ".", Colors::White, Colors::Green);
+
+         THEN("Every pixel is either copied or cleared") {
+            for (int y = 0; y < 4; ++y) {
+               for (int x = 0; x < 10; ++x) {
+                  const auto pixel = image.GetPixel(x, y);
+                  if (coverage.GetMask().GetRow(y)[x]) {
+                     REQUIRE(pixel.mSymbol == "#");
+                     REQUIRE(pixel.mBgColor == RGBAf {Colors::Blue});
+                  }
+                  else {
+                     REQUIRE(pixel.mSymbol == ".");
+                     REQUIRE(pixel.mBgColor == RGBAf {Colors::Green});
+                  }
+               }
+            }
+         }
+      }
+
+      WHEN("The other image is blended through the coverage") {
+         image.Blend(other, coverage);
+
+         THEN("Only covered pixels change") {
+            REQUIRE(image.GetPixel(2, 1).mSymbol == "#");
+            REQUIRE(image.GetPixel(8, 2).mSymbol == "#");
+            REQUIRE(image.GetPixel(5, 2).mSymbol == " ");
+            REQUIRE(image.GetPixel(5, 2).mBgColor == RGBAf {Colors::Black});
+            REQUIRE(image.GetPixel(0, 0).mBgColor == RGBAf {Colors::Black});
+         }
+      }
+
+      WHEN("The coverage is cleared") {
+         coverage.Clear();
+
+         THEN("The mask and spans are empty again") {
+            REQUIRE(coverage.IsEmpty());
+            REQUIRE(coverage.GetCount() == 0);
+            REQUIRE(coverage.GetSpan(1).IsEmpty());
+            REQUIRE(coverage.GetMask().Matches(0));
+         }
+      }
+   }
+
+   REQUIRE(memoryState.Assert());
+}
+
+SCENARIO("Resizing ASCII buffers and images within capacity", "[buffer]") {
+   static Allocator::State memoryState;
+
+   GIVEN("An 8x6 buffer with distinct pixels") {
+      ASCIIBuffer<int> buffer;
+      buffer.Resize(8, 6);
+      for (int y = 0; y < 6; ++y) {
+         for (int x = 0; x < 8; ++x)
+            buffer.Get(x, y) = y * 8 + x + 1;
+      }
+
+      const auto stride = buffer.GetStride();
+      const auto bytes = buffer.GetBytes();
+      REQUIRE(stride >= 8);
+
+      WHEN("Grown slightly") {
+         buffer.Resize(9, 7);
+
+         THEN("Storage is reused, old pixels are kept, new ones cleared") {
+            REQUIRE(buffer.GetStride() == stride);
+            REQUIRE(buffer.GetBytes() == bytes);
+            for (int y = 0; y < 7; ++y) {
+               for (int x = 0; x < 9; ++x) {
+                  const bool old = x < 8 and y < 6;
+                  REQUIRE(buffer.Get(x, y) == (old ? y * 8 + x + 1 : 0));
+               }
+            }
+         }
+      }
+
+      WHEN("Shrunk slightly, and grown back") {
+         buffer.Resize(7, 5);
+         buffer.Resize(8, 6);
+
+         THEN("Storage is reused, and the exposed area is cleared") {
+            REQUIRE(buffer.GetStride() == stride);
+            REQUIRE(buffer.GetBytes() == bytes);
+            REQUIRE(buffer.Get(6, 4) == 4 * 8 + 6 + 1);
+            REQUIRE(buffer.Get(7, 0) == 0);
+            REQUIRE(buffer.Get(0, 5) == 0);
+         }
+      }
+
+      WHEN("Shrunk well below capacity") {
+         buffer.Resize(2, 2);
+
+         THEN("Storage is released") {
+            REQUIRE(buffer.GetStride() < stride);
+            REQUIRE(buffer.GetBytes() < bytes);
+         }
+      }
+
+      WHEN("Grown beyond capacity") {
+         buffer.Resize(stride + 1, 6);
+
+         THEN("Storage is reallocated") {
+            REQUIRE(buffer.GetStride() > stride);
+            REQUIRE(buffer.GetWidth() == stride + 1);
+         }
+      }
+   }
+
+   GIVEN("An 8x6 image") {
+      ASCIIImage image {nullptr};
+      image.Resize(8, 6);
+      image.Fill("#", Colors::Red, Colors::Blue);
+
+      const auto stride = image.GetStride();
+      const auto bytes = image.GetBytes();
+
+      WHEN("Grown slightly") {
+         image.Resize(9, 7);
+
+         THEN("Storage is reused, old pixels are kept, new ones cleared") {
+            REQUIRE(image.GetStride() == stride);
+            REQUIRE(image.GetBytes() == bytes);
+            REQUIRE(image.GetPixel(7, 5).mSymbol == "#");
+            REQUIRE(image.GetPixel(8, 0).mSymbol == " ");
+            REQUIRE(image.GetPixel(0, 6).mSymbol == " ");
+         }
+      }
+
+      WHEN("Filled and copied after a resize") {
+         image.Resize(9, 7);
+         ASCIIImage other {nullptr};
+         other.Resize(9, 7);
+         other.Fill("@");
+         image.Copy(other);
+
+         THEN("Images with different strides still copy row by row") {
+            REQUIRE(image.Matches(other));
+         }
+      }
+   }
+
+   REQUIRE(memoryState.Assert());
+}
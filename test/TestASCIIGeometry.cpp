@@ -0,0 +1,241 @@
+///                                                                           
+/// Langulus::Module::ASCII                                                   
+/// Copyright (c) 2024 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "../source/inner/ASCIIGeometry.hpp"
+#include <Langulus/Testing.hpp>
+#include <cstring>
+#include <fstream>
+
+using Vertex = ASCIIGeometry::Vertex;
+using Level = ASCIIGeometry::Level;
+
+
+namespace
+{
+   /// Make a triangle list of a finely tessellated, slightly bumpy square    
+   ///   @param n - number of quads along each side                           
+   ///   @return the triangle list                                            
+   Level Grid(int n) {
+      Level level;
+      auto vertex = [n](int x, int y) {
+         Vertex v;
+         const Real fx = static_cast<Real>(x) / n;
+         const Real fy = static_cast<Real>(y) / n;
+         v.mPos = Vec4 {fx, fy, ((x + y) % 2) * 0.001f, 1};
+         v.mTex = Vec2 {fx, fy};
+         return v;
+      };
+
+      for (int y = 0; y < n; ++y) {
+         for (int x = 0; x < n; ++x) {
+            level.mVertices.push_back(vertex(x, y));
+            level.mVertices.push_back(vertex(x + 1, y));
+            level.mVertices.push_back(vertex(x + 1, y + 1));
+            level.mVertices.push_back(vertex(x, y));
+            level.mVertices.push_back(vertex(x + 1, y + 1));
+            level.mVertices.push_back(vertex(x, y + 1));
+         }
+      }
+      return level;
+   }
+}
+
+SCENARIO("Simplifying geometry, and picking a level of detail", "[geometry]") {
+   GIVEN("A finely tessellated square") {
+      std::vector<Level> levels;
+      levels.push_back(Grid(64));
+      const ASCIIBounds bounds {Vec3 {0, 0, 0}, Vec3 {1, 1, 0.001f}};
+      const auto original = levels.front().mVertices.size();
+
+      WHEN("Simplified") {
+         ASCIIGeometry::Simplify(levels, bounds);
+
+         THEN("Progressively coarser triangle lists are generated") {
+            REQUIRE(levels.size() > 1);
+            REQUIRE(levels.front().mVertices.size() == original);
+            REQUIRE(levels.front().mError == 0);
+
+            for (size_t i = 1; i < levels.size(); ++i) {
+               const auto& level = levels[i];
+               const auto& previous = levels[i - 1];
+               REQUIRE(level.mVertices.size() % 3 == 0);
+               REQUIRE(level.mVertices.size() * 4 <= previous.mVertices.size() * 3);
+               REQUIRE(level.mError > 0);
+               REQUIRE(level.mError >= previous.mError);
+
+               // Vertices only move inside the bounds of the original  
+               for (const auto& v : level.mVertices) {
+                  REQUIRE(v.mPos.x >= 0);
+                  REQUIRE(v.mPos.x <= 1);
+                  REQUIRE(v.mPos.y >= 0);
+                  REQUIRE(v.mPos.y <= 1);
+               }
+            }
+         }
+
+         THEN("The level of detail is picked by projected error") {
+            // Only the simplified levels are selectable, so that a     
+            // level of detail of N is levels[N]                        
+            const std::vector<Level> simplified (levels.begin() + 1, levels.end());
+
+            // Far away, everything fits in a pixel                     
+            REQUIRE(ASCIIGeometry::SelectLOD(simplified, 0) == simplified.size());
+            // Up close, no simplification is good enough               
+            REQUIRE(ASCIIGeometry::SelectLOD(simplified, 1e9f) == 0);
+
+            // In between, the coarsest level under a pixel is picked   
+            for (size_t lod = 1; lod < levels.size(); ++lod) {
+               const Real pixelsPerUnit = Real {0.999f} / levels[lod].mError;
+               const auto picked = ASCIIGeometry::SelectLOD(simplified, pixelsPerUnit);
+               REQUIRE(picked >= lod);
+               REQUIRE(levels[picked].mError * pixelsPerUnit <= 1);
+               if (picked + 1 < levels.size())
+                  REQUIRE(levels[picked + 1].mError * pixelsPerUnit > 1);
+            }
+         }
+      }
+   }
+
+   GIVEN("Degenerate geometry") {
+      std::vector<Level> levels;
+      levels.push_back({std::vector<Vertex>(3), 0});
+      const ASCIIBounds bounds {Vec3 {0, 0, 0}, Vec3 {0, 0, 0}};
+
+      WHEN("Simplified") {
+         ASCIIGeometry::Simplify(levels, bounds);
+
+         THEN("Nothing is generated") {
+            REQUIRE(levels.size() == 1);
+         }
+      }
+   }
+}
+
+SCENARIO("Caching converted geometry on disk", "[geometry]") {
+   struct V { float mData[4]; };
+   const auto folder = std::filesystem::temp_directory_path() / "langulus-ascii-cache-test";
+   std::filesystem::remove_all(folder);
+
+   std::vector<V> original(300), simplified(30);
+   for (size_t i = 0; i < original.size(); ++i)
+      original[i] = {{float(i), float(i) * 2, float(i) * 3, 1}};
+   for (size_t i = 0; i < simplified.size(); ++i)
+      simplified[i] = {{float(i) * 10, 0, 0, 1}};
+
+   Range4 range;
+   range.mMin = Vec4 {-1, -2, -3, 1};
+   range.mMax = Vec4 {1, 2, 3, 1};
+
+   const std::vector<ASCIIGeometryCache::Level> levels {
+      {original.data(), original.size(), 0},
+      {simplified.data(), simplified.size(), 0.5f}
+   };
+
+   auto same = [](const ASCIIGeometryCache::Level& level, const std::vector<V>& data) {
+      return level.mCount == data.size() and 0 == std::memcmp(
+         level.mVertices, data.data(), data.size() * sizeof(V));
+   };
+
+   GIVEN("A cache in a temporary folder") {
+      const ASCIIGeometryCache cache {folder};
+      REQUIRE(cache.IsEnabled());
+
+      WHEN("An entry is stored and loaded") {
+         cache.Store(42, sizeof(V), range, levels);
+
+         ASCIIGeometryCache::Entry entry;
+         REQUIRE(cache.Load(42, sizeof(V), entry));
+
+         THEN("The same data is mapped back") {
+            REQUIRE(entry.mRange.mMin == range.mMin);
+            REQUIRE(entry.mRange.mMax == range.mMax);
+            REQUIRE(entry.mLevels.size() == 2);
+            REQUIRE(same(entry.mLevels[0], original));
+            REQUIRE(same(entry.mLevels[1], simplified));
+            REQUIRE(entry.mLevels[1].mError == 0.5f);
+         }
+
+         THEN("No temporary files are left behind") {
+            size_t files = 0;
+            for (auto& file : std::filesystem::directory_iterator {folder}) {
+               REQUIRE(file.path().extension() == ".geometry");
+               ++files;
+            }
+            REQUIRE(files == 1);
+         }
+
+         THEN("Other keys and vertex sizes are rejected") {
+            ASCIIGeometryCache::Entry other;
+            REQUIRE_FALSE(cache.Load(43, sizeof(V), other));
+            REQUIRE_FALSE(cache.Load(42, sizeof(V) * 2, other));
+         }
+      }
+
+      WHEN("An entry is stored again with other data") {
+         cache.Store(42, sizeof(V), range, levels);
+         cache.Store(42, sizeof(V), range, {{simplified.data(), simplified.size(), 0}});
+
+         THEN("The existing entry is kept") {
+            ASCIIGeometryCache::Entry entry;
+            REQUIRE(cache.Load(42, sizeof(V), entry));
+            REQUIRE(entry.mLevels.size() == 2);
+            REQUIRE(same(entry.mLevels[0], original));
+         }
+      }
+
+      WHEN("An entry is corrupted") {
+         cache.Store(42, sizeof(V), range, levels);
+         std::filesystem::path path;
+         for (auto& file : std::filesystem::directory_iterator {folder})
+            path = file.path();
+
+         const auto size = std::filesystem::file_size(path);
+
+         THEN("A truncated file is rejected") {
+            std::filesystem::resize_file(path, size / 2);
+            ASCIIGeometryCache::Entry entry;
+            REQUIRE_FALSE(cache.Load(42, sizeof(V), entry));
+         }
+
+         THEN("A file with a bad signature is rejected, and replaced on store") {
+            {
+               std::fstream file {path, std::ios::binary | std::ios::in | std::ios::out};
+               file.write("XXXX", 4);
+            }
+
+            ASCIIGeometryCache::Entry entry;
+            REQUIRE_FALSE(cache.Load(42, sizeof(V), entry));
+
+            cache.Store(42, sizeof(V), range, levels);
+            REQUIRE(cache.Load(42, sizeof(V), entry));
+            REQUIRE(same(entry.mLevels[0], original));
+         }
+
+         THEN("An empty file is rejected") {
+            std::filesystem::resize_file(path, 0);
+            ASCIIGeometryCache::Entry entry;
+            REQUIRE_FALSE(cache.Load(42, sizeof(V), entry));
+         }
+      }
+   }
+
+   GIVEN("A disabled cache") {
+      const ASCIIGeometryCache cache {std::filesystem::path {}};
+      REQUIRE_FALSE(cache.IsEnabled());
+
+      WHEN("An entry is stored") {
+         cache.Store(42, sizeof(V), range, levels);
+
+         THEN("Nothing is written, and nothing is loaded") {
+            ASCIIGeometryCache::Entry entry;
+            REQUIRE_FALSE(cache.Load(42, sizeof(V), entry));
+         }
+      }
+   }
+
+   std::filesystem::remove_all(folder);
+}
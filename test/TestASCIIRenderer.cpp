@@ -5,6 +5,7 @@
 ///                                                                           
 /// SPDX-License-Identifier: GPL-3.0-or-later                                 
 ///                                                                           
+#include "../source/ASCII.hpp"
 #include <Langulus/Flow/Time.hpp>
 #include <Langulus/Platform.hpp>
 #include <Langulus/Graphics.hpp>
@@ -14,6 +15,7 @@
 #include <Langulus/Verbs/Interpret.hpp>
 #include <Langulus/Verbs/Compare.hpp>
 #include <Langulus/Testing.hpp>
+#include <thread>
 
 
 SCENARIO("Renderer creation inside a window", "[renderer]") {
@@ -175,3 +177,74 @@ SCENARIO("Drawing solid polygons", "[renderer]") {
    REQUIRE(memoryState.Assert());
 }
 
+SCENARIO("Gathering statistics of rendered frames", "[renderer]") {
+   static Allocator::State memoryState;
+
+   GIVEN("A window with a renderer, and a few polygons") {
+      auto root = Thing::Root<false>(
+         "FTXUI",
+         "ASCII",
+         "FileSystem",
+         "AssetsGeometry",
+         "Physics"
+      );
+      root.CreateUnits<A::Window, A::Layer, A::World>();
+      auto renderer = root.CreateUnit<A::Renderer>().template As<ASCIIRenderer*>();
+      REQUIRE(renderer);
+
+      auto rect = root.CreateChild(Traits::Size {10, 5}, "Rectangles");
+      rect->CreateUnit<A::Renderable>();
+      rect->CreateUnit<A::Mesh>(Math::Box2 {});
+      rect->CreateUnit<A::Instance>(Traits::Place(10, 10), Colors::Black);
+      rect->CreateUnit<A::Instance>(Traits::Place(50, 10), Colors::Green);
+
+      WHEN("Frames are rendered, until the polygons are converted and drawn") {
+         // Geometry is converted in the background, so the first few   
+         // frames might not draw anything                              
+         root.Update(16ms);
+         auto stats = renderer->GetStatistics();
+         for (int tries = 0; tries != 1000 and not stats.mInstancesDrawn; ++tries) {
+            std::this_thread::sleep_for(1ms);
+            root.Update(16ms);
+            stats = renderer->GetStatistics();
+         }
+
+         const auto memory = renderer->GetMemoryStats();
+
+         THEN("The last frame is reported") {
+            REQUIRE(stats.mFrame == renderer->GetFrame());
+            REQUIRE(stats.mGenerateTime >= 0);
+            REQUIRE(stats.mRenderTime >= stats.mCompositeTime);
+            REQUIRE(stats.mBufferBytes > 0);
+         }
+
+         THEN("Instances are either culled or drawn") {
+            REQUIRE(stats.mInstancesDrawn > 0);
+            REQUIRE(stats.mInstancesConsidered
+               == stats.mInstancesCulled + stats.mInstancesDrawn);
+         }
+
+         THEN("The polygons reach the screen") {
+            REQUIRE(stats.mPipelines.mTriangles > 0);
+            REQUIRE(stats.mPipelines.mPixelsAssembled > 0);
+         }
+
+         THEN("Pixels are counted in the same unit as fragments") {
+            // Each assembled pixel got at least one fragment through   
+            const auto& pipes = stats.mPipelines;
+            REQUIRE(pipes.mFragmentsPassed >= pipes.mPixelsAssembled);
+            REQUIRE(pipes.mFragmentsTested >= pipes.mFragmentsPassed);
+            REQUIRE(stats.mOverdraw >= 1);
+         }
+
+         THEN("Converted content is accounted for") {
+            REQUIRE(memory.mBudget > 0);
+            REQUIRE(memory.mResident <= memory.mEntries);
+            REQUIRE(memory.mGeometryBytes + memory.mTextureBytes <= memory.mBudget);
+         }
+      }
+   }
+
+   // Check for memory leaks                                            
+   REQUIRE(memoryState.Assert());
+}
@@ -0,0 +1,238 @@
+///                                                                           
+/// Langulus::Module::ASCII                                                   
+/// Copyright (c) 2024 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "../source/ASCIIPipeline.hpp"
+#include <Langulus/Testing.hpp>
+#include <cmath>
+
+
+namespace
+{
+   constexpr Real Epsilon = 0.0001f;
+
+   /// Get a corner of a box                                                  
+   Vec3 Corner(const ASCIIBounds& box, int i) {
+      return {
+         i & 1 ? box.mMax.x : box.mMin.x,
+         i & 2 ? box.mMax.y : box.mMin.y,
+         i & 4 ? box.mMax.z : box.mMin.z
+      };
+   }
+
+   /// Check if a projected point is inside the shadowmap and depth range     
+   bool Inside(const Vec3& p) {
+      return p.x >= -Epsilon and p.x <= 1 + Epsilon
+         and p.y >= -Epsilon and p.y <= 1 + Epsilon
+         and p.z >= -Epsilon and p.z <= 1 + Epsilon;
+   }
+}
+
+SCENARIO("Fitting shadow projections around visible content", "[shadow]") {
+   const ASCIIBounds receivers {Vec3 {-2, 0, -1}, Vec3 {2, 0.5f, 1}};
+   const ASCIIBounds caster {Vec3 {-0.5f, 5, -0.5f}, Vec3 {0.5f, 6, 0.5f}};
+   const ASCIIBounds casters = receivers.Merge(caster);
+
+   GIVEN("A directional light above the content") {
+      const Vec3 position {0, 10, 0};
+      const Vec3 direction {0, 1, 0};
+
+      WHEN("Fitted") {
+         ShadowFrustum frustum;
+         REQUIRE(frustum.Fit(position, direction, 0, receivers, casters));
+
+         THEN("The projection is orthographic, and looks down") {
+            REQUIRE_FALSE(frustum.mPerspective);
+            REQUIRE(frustum.mForward.y == -1);
+         }
+
+         THEN("All receivers fit tightly in the shadowmap") {
+            Vec2 lo {1, 1}, hi {0, 0};
+            for (int i = 0; i < 8; ++i) {
+               const auto p = frustum.Project(Corner(receivers, i));
+               REQUIRE(Inside(p));
+               lo = {std::min(lo.x, p.x), std::min(lo.y, p.y)};
+               hi = {std::max(hi.x, p.x), std::max(hi.y, p.y)};
+            }
+
+            REQUIRE(std::abs(lo.x) < Epsilon);
+            REQUIRE(std::abs(lo.y) < Epsilon);
+            REQUIRE(std::abs(hi.x - 1) < Epsilon);
+            REQUIRE(std::abs(hi.y - 1) < Epsilon);
+         }
+
+         THEN("The depth range starts at the nearest caster") {
+            REQUIRE(std::abs(frustum.mDepth.mMin - 4) < Epsilon);
+            REQUIRE(std::abs(frustum.mDepth.mMax - 10) < Epsilon);
+            for (int i = 0; i < 8; ++i)
+               REQUIRE(Inside(frustum.Project(Corner(caster, i))));
+         }
+      }
+
+      WHEN("Fitted to nothing") {
+         const ASCIIBounds empty {Vec3 {1, 1, 1}, Vec3 {-1, -1, -1}};
+         ShadowFrustum frustum;
+
+         THEN("There's nothing to shadow") {
+            REQUIRE_FALSE(frustum.Fit(position, direction, 0, empty, casters));
+         }
+      }
+   }
+
+   GIVEN("A spot light above the content, with a 60 degree cone") {
+      const Vec3 position {0, 10, 0};
+      const Vec3 direction {0, 1, 0};
+      const Real spread = std::cos(Real {0.5236f});
+      const Real limit = std::sqrt(1 - spread * spread) / spread;
+
+      WHEN("Fitted around small receivers") {
+         ShadowFrustum frustum;
+         REQUIRE(frustum.Fit(position, direction, spread, receivers, casters));
+
+         THEN("The projection is perspective, and covers all receivers") {
+            REQUIRE(frustum.mPerspective);
+            for (int i = 0; i < 8; ++i)
+               REQUIRE(Inside(frustum.Project(Corner(receivers, i))));
+         }
+      }
+
+      WHEN("Fitted around receivers much larger than the cone") {
+         const ASCIIBounds huge {Vec3 {-100, 0, -100}, Vec3 {100, 0.5f, 100}};
+         ShadowFrustum frustum;
+         REQUIRE(frustum.Fit(position, direction, spread, huge, huge.Merge(caster)));
+
+         THEN("The shadowmap covers only the cone") {
+            REQUIRE(1 / frustum.mScale.x <= limit + Epsilon);
+            REQUIRE(1 / frustum.mScale.y <= limit + Epsilon);
+            REQUIRE_FALSE(Inside(frustum.Project(Corner(huge, 0))));
+         }
+      }
+
+      WHEN("Fitted around receivers behind the light") {
+         const ASCIIBounds behind {Vec3 {-1, 20, -1}, Vec3 {1, 21, 1}};
+         ShadowFrustum frustum;
+
+         THEN("There's nothing to shadow") {
+            REQUIRE_FALSE(frustum.Fit(position, direction, spread, behind, behind));
+         }
+      }
+   }
+}
+
+SCENARIO("Reusing shadow projections between frames", "[shadow]") {
+   const ASCIIBounds receivers {Vec3 {-2, 0, -1}, Vec3 {2, 0.5f, 1}};
+   const ASCIIBounds casters = receivers.Merge({Vec3 {-0.5f, 5, -0.5f}, Vec3 {0.5f, 6, 0.5f}});
+   const Vec3 position {0, 10, 0};
+   const Vec3 direction {0, 1, 0};
+
+   for (Real spread : {Real {0}, Real {0.8f}}) {
+      GIVEN(spread ? "A spot light" : "A directional light") {
+         ShadowFrustum fitted;
+         REQUIRE(fitted.Fit(position, direction, spread, receivers, casters));
+         const auto grown = fitted.Grow(0.1f);
+
+         THEN("A projection contains itself") {
+            REQUIRE(fitted.Contains(fitted));
+         }
+
+         THEN("A grown projection contains the fitted one, but not vice versa") {
+            REQUIRE(grown.Contains(fitted));
+            REQUIRE_FALSE(fitted.Contains(grown));
+            REQUIRE(grown.mDepth.mMin < fitted.mDepth.mMin);
+            REQUIRE(grown.mDepth.mMax > fitted.mDepth.mMax);
+            REQUIRE(grown.mDepth.mMin > 0);
+         }
+
+         WHEN("The content moves a little") {
+            const Vec3 offset {0.05f, 0, 0.05f};
+            const ASCIIBounds moved {receivers.mMin + offset, receivers.mMax + offset};
+            ShadowFrustum refitted;
+            REQUIRE(refitted.Fit(position, direction, spread, moved, casters));
+
+            THEN("The grown projection can be reused") {
+               REQUIRE(grown.Contains(refitted));
+            }
+         }
+
+         WHEN("The content moves a lot") {
+            const Vec3 offset {3, 0, 0};
+            const ASCIIBounds moved {receivers.mMin + offset, receivers.mMax + offset};
+            ShadowFrustum refitted;
+            REQUIRE(refitted.Fit(position, direction, spread, moved, casters.Merge(moved)));
+
+            THEN("The projection has to be rendered again") {
+               REQUIRE_FALSE(grown.Contains(refitted));
+            }
+         }
+
+         WHEN("The light moves") {
+            ShadowFrustum refitted;
+            REQUIRE(refitted.Fit(position + Vec3 {0, 0.01f, 0}, direction, spread, receivers, casters));
+
+            THEN("The projection has to be rendered again") {
+               REQUIRE_FALSE(grown.Contains(refitted));
+            }
+         }
+
+         WHEN("The light type changes") {
+            ShadowFrustum refitted;
+            REQUIRE(refitted.Fit(position, direction, spread ? 0 : Real {0.8f}, receivers, casters));
+
+            THEN("The projection has to be rendered again") {
+               REQUIRE_FALSE(grown.Contains(refitted));
+            }
+         }
+      }
+   }
+}
+
+SCENARIO("Gathering shadow casters outside of the view", "[shadow]") {
+   // Only the receivers are visible - casters are off-screen           
+   const ASCIIBounds receivers {Vec3 {-2, 0, -1}, Vec3 {2, 0.5f, 1}};
+   const ASCIIBounds above {Vec3 {-0.5f, 5, -0.5f}, Vec3 {0.5f, 6, 0.5f}};
+   const ASCIIBounds aside {Vec3 {10, 5, -0.5f}, Vec3 {11, 6, 0.5f}};
+   const ASCIIBounds below {Vec3 {-0.5f, -6, -0.5f}, Vec3 {0.5f, -5, 0.5f}};
+   const ASCIIBounds behind {Vec3 {-0.5f, 20, -0.5f}, Vec3 {0.5f, 21, 0.5f}};
+   const Vec3 position {0, 10, 0};
+   const Vec3 direction {0, 1, 0};
+
+   for (Real spread : {Real {0}, Real {0.8f}}) {
+      GIVEN(spread ? "A spot light" : "A directional light") {
+         ShadowFrustum frustum;
+         REQUIRE(frustum.Fit(position, direction, spread, receivers, receivers));
+
+         THEN("Casters between the light and the receivers reach them") {
+            REQUIRE(frustum.Reaches(receivers));
+            REQUIRE(frustum.Reaches(above));
+         }
+
+         THEN("Casters beside, or behind the receivers don't") {
+            REQUIRE_FALSE(frustum.Reaches(aside));
+            REQUIRE_FALSE(frustum.Reaches(below));
+         }
+
+         WHEN("Fitted again with an off-screen caster") {
+            REQUIRE(frustum.Fit(position, direction, spread, receivers, receivers.Merge(above)));
+
+            THEN("The depth range starts at the caster") {
+               for (int i = 0; i < 8; ++i) {
+                  REQUIRE(Inside(frustum.Project(Corner(above, i))));
+                  REQUIRE(Inside(frustum.Project(Corner(receivers, i))));
+               }
+            }
+         }
+      }
+   }
+
+   GIVEN("A spot light") {
+      ShadowFrustum frustum;
+      REQUIRE(frustum.Fit(position, direction, 0.8f, receivers, receivers));
+
+      THEN("Casters behind its apex don't reach the receivers") {
+         REQUIRE_FALSE(frustum.Reaches(behind));
+      }
+   }
+}
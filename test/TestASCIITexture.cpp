@@ -0,0 +1,97 @@
+///                                                                           
+/// Langulus::Module::ASCII                                                   
+/// Copyright (c) 2024 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "../source/inner/ASCIITexture.hpp"
+#include <Langulus/Testing.hpp>
+
+
+namespace
+{
+   constexpr int TileSize = ASCIITexture::TileSize;
+
+   /// Fetch a texel from a tiled mip                                         
+   RGBA Texel(const ASCIITexture::MipChain& chain, size_t mip, int x, int y) {
+      const auto& m = chain.mMips[mip];
+      return chain.mTexels[m.mOffset
+         + ((y / TileSize) * m.mTiles + x / TileSize) * TileSize * TileSize
+         + (y % TileSize) * TileSize + x % TileSize];
+   }
+
+   /// Make an image of a single color                                        
+   std::vector<RGBA> Fill(int width, int height, const RGBA& color) {
+      return std::vector<RGBA>(static_cast<size_t>(width) * height, color);
+   }
+}
+
+SCENARIO("Generating texture mip chains", "[texture]") {
+   GIVEN("An 8x4 image of a single color") {
+      const RGBA color {10, 20, 30, 255};
+      const auto chain = ASCIITexture::BuildMipChain(Fill(8, 4, color), 8, 4);
+
+      THEN("Mips are halved down to a single texel") {
+         const int sizes[][2] {{8, 4}, {4, 2}, {2, 1}, {1, 1}};
+         REQUIRE(chain.mMips.size() == 4);
+         for (size_t i = 0; i < chain.mMips.size(); ++i) {
+            REQUIRE(chain.mMips[i].mWidth == sizes[i][0]);
+            REQUIRE(chain.mMips[i].mHeight == sizes[i][1]);
+         }
+      }
+
+      THEN("Each mip is padded to whole tiles, right after the previous one") {
+         size_t offset = 0;
+         for (const auto& m : chain.mMips) {
+            const int tilesy = (m.mHeight + TileSize - 1) / TileSize;
+            REQUIRE(m.mTiles == (m.mWidth + TileSize - 1) / TileSize);
+            REQUIRE(m.mOffset == offset);
+            offset += static_cast<size_t>(m.mTiles) * tilesy * TileSize * TileSize;
+         }
+         REQUIRE(chain.mTexels.size() == offset);
+      }
+
+      THEN("The color is preserved in every mip") {
+         for (size_t i = 0; i < chain.mMips.size(); ++i) {
+            for (int y = 0; y < chain.mMips[i].mHeight; ++y) {
+               for (int x = 0; x < chain.mMips[i].mWidth; ++x)
+                  REQUIRE(Texel(chain, i, x, y) == color);
+            }
+         }
+      }
+   }
+
+   GIVEN("A 2x2 image of four colors") {
+      const std::vector<RGBA> image {
+         {0,   0,   0,   255}, {200, 0,   0,   255},
+         {0,   100, 0,   255}, {0,   0,   40,  255}
+      };
+      const auto chain = ASCIITexture::BuildMipChain(std::vector<RGBA> {image}, 2, 2);
+
+      THEN("The top mip is kept as it is") {
+         REQUIRE(chain.mMips.size() == 2);
+         for (int y = 0; y < 2; ++y) {
+            for (int x = 0; x < 2; ++x)
+               REQUIRE(Texel(chain, 0, x, y) == image[y * 2 + x]);
+         }
+      }
+
+      THEN("The last mip is the rounded average") {
+         REQUIRE(Texel(chain, 1, 0, 0) == RGBA {50, 25, 10, 255});
+      }
+   }
+
+   GIVEN("An odd-sized, non-square image") {
+      const auto chain = ASCIITexture::BuildMipChain(Fill(5, 1, RGBA {1, 2, 3, 4}), 5, 1);
+
+      THEN("Mips never shrink below a single texel on either side") {
+         const int sizes[][2] {{5, 1}, {2, 1}, {1, 1}};
+         REQUIRE(chain.mMips.size() == 3);
+         for (size_t i = 0; i < chain.mMips.size(); ++i) {
+            REQUIRE(chain.mMips[i].mWidth == sizes[i][0]);
+            REQUIRE(chain.mMips[i].mHeight == sizes[i][1]);
+         }
+      }
+   }
+}
@@ -0,0 +1,82 @@
+///                                                                           
+/// Langulus::Module::ASCII                                                   
+/// Copyright (c) 2024 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "../source/inner/ASCIIThreadPool.hpp"
+#include <Langulus/Testing.hpp>
+#include <future>
+#include <stdexcept>
+
+
+SCENARIO("Running tasks on the ASCII thread pool", "[threadpool]") {
+   for (unsigned workers : {1u, 2u, 4u}) {
+      GIVEN(std::string("A pool with ") + std::to_string(workers) + " workers") {
+         ASCIIThreadPool pool {workers};
+         REQUIRE(pool.GetWorkerCount() == workers - 1);
+
+         WHEN("Each index of a range is processed in parallel") {
+            std::vector<std::atomic<int>> hits(1000);
+            pool.ParallelFor(hits.size(), [&](size_t i) {
+               hits[i].fetch_add(1);
+            });
+
+            THEN("Every index is processed exactly once") {
+               for (auto& hit : hits)
+                  REQUIRE(hit.load() == 1);
+            }
+         }
+
+         WHEN("Parallel loops are nested") {
+            std::atomic<size_t> sum = 0;
+            pool.ParallelFor(8, [&](size_t i) {
+               pool.ParallelFor(8, [&](size_t j) {
+                  sum.fetch_add(i * 8 + j);
+               });
+            });
+
+            THEN("All inner indices are processed") {
+               REQUIRE(sum.load() == 64 * 63 / 2);
+            }
+         }
+
+         WHEN("Some of the tasks throw") {
+            std::atomic<int> done = 0;
+            bool thrown = false;
+            try {
+               pool.ParallelFor(100, [&](size_t i) {
+                  if (i % 10 == 3)
+                     throw std::runtime_error("task failed");
+                  done.fetch_add(1);
+               });
+            }
+            catch (const std::runtime_error&) {
+               thrown = true;
+            }
+
+            THEN("The exception reaches the caller after all tasks are done") {
+               REQUIRE(thrown);
+               REQUIRE(done.load() == 90);
+            }
+
+            THEN("The pool remains usable") {
+               std::atomic<int> after = 0;
+               pool.ParallelFor(16, [&](size_t) { after.fetch_add(1); });
+               REQUIRE(after.load() == 16);
+            }
+         }
+
+         WHEN("A background job is submitted") {
+            std::promise<int> result;
+            auto future = result.get_future();
+            pool.Submit([&result] { result.set_value(42); });
+
+            THEN("It is eventually executed") {
+               REQUIRE(future.get() == 42);
+            }
+         }
+      }
+   }
+}